@@ -0,0 +1,65 @@
+// Convolver cost per channel for a range of IR lengths
+// the stream is paced `speed` times faster than real time, so the tail
+// thread runs as it would behind an audio callback; reports the time
+// process() takes on the calling thread and the cpu of both threads
+// (std::clock, process cpu time on posix)
+//
+// usage: convolver_bench [block] [speed] [channels]
+
+#include "audioplus/convolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+using namespace audioplus;
+
+int main(int argc, char ** argv)
+{
+    int block = argc > 1 ? std::atoi(argv[1]) : 64;
+    double speed = argc > 2 ? std::atof(argv[2]) : 10;
+    int channels = argc > 3 ? std::atoi(argv[3]) : 2;
+    double const rate = 48000;
+    double const seconds = 10;
+
+    std::printf("block %d, %d channels, paced at %gx real time\n", block, channels, speed);
+    std::printf("%8s %6s %14s %14s %12s %6s\n",
+        "ir", "tail", "us/block/ch", "max us/block", "cpu % / ch", "late");
+    for(double ir_seconds : {0.1, 0.5, 1.0, 2.0, 5.0})
+    {
+        int len = int(ir_seconds * rate);
+        std::vector<std::vector<float>> ir(channels, std::vector<float>(len));
+        for(auto & h : ir)
+            for(int i=0 ; i<len ; i++) { h[i] = std::exp(-6.0f * i / len) * std::sin(0.37f * i); }
+
+        Convolver conv(ir, block);
+        std::vector<float> x(size_t(block) * channels);
+        for(size_t i=0 ; i<x.size() ; i++) { x[i] = std::sin(0.01f * i); }
+        std::vector<float> y(x.size());
+
+        using clock = std::chrono::steady_clock;
+        int blocks = int(seconds * rate / block);
+        auto period = std::chrono::duration<double>(block / rate / speed);
+        double total = 0, worst = 0;
+        std::clock_t cpu_start = std::clock();
+        auto start = clock::now();
+        for(int b=0 ; b<blocks ; b++)
+        {
+            auto t0 = clock::now();
+            conv.process(x.data(), y.data(), block);
+            std::chrono::duration<double, std::micro> t = clock::now() - t0;
+            total += t.count();
+            worst = std::max(worst, t.count());
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<clock::duration>(period * (b + 1)));
+        }
+        double cpu = double(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+        std::printf("%7.1fs %6d %14.2f %14.1f %11.2f%% %6d\n", ir_seconds, conv.tail_block(),
+            total / blocks / channels, worst, 100 * cpu / (seconds * channels), conv.late_tail_blocks());
+    }
+    return 0;
+}
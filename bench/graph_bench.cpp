@@ -0,0 +1,123 @@
+// how Graph::on_audio scales with worker threads
+// `chains` parallel biquad cascades mixed into a stereo output,
+// timed per callback for 0 .. hardware_concurrency-1 workers
+//
+// usage: graph_bench [chains] [stages] [frames] [max_workers]
+
+#include "audioplus/graph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace audioplus;
+
+// `stages` cascaded biquads, enough work per node to be worth a thread
+struct Cascade : GraphNode
+{
+    int stages;
+    std::vector<float> z;
+
+    Cascade(int stages) : GraphNode(1, 1), stages(stages), z(stages * 2) {}
+
+    void process(float const* const* in, float * const* out, int frames) override
+    {
+        // lowpass at fs/8, q 0.7
+        float const b0 = 0.0976f, b1 = 0.1953f, b2 = 0.0976f, a1 = -0.9428f, a2 = 0.3333f;
+        std::copy(in[0], in[0] + frames, out[0]);
+        for(int s=0 ; s<stages ; s++)
+        {
+            float z1 = z[2*s], z2 = z[2*s+1];
+            for(int i=0 ; i<frames ; i++)
+            {
+                float x = out[0][i];
+                float y = b0 * x + z1;
+                z1 = b1 * x - a1 * y + z2;
+                z2 = b2 * x - a2 * y;
+                out[0][i] = y;
+            }
+            z[2*s] = z1;
+            z[2*s+1] = z2;
+        }
+    }
+};
+
+struct Mix : GraphNode
+{
+    Mix(int inputs) : GraphNode(inputs, 1) {}
+
+    void process(float const* const* in, float * const* out, int frames) override
+    {
+        std::fill(out[0], out[0] + frames, 0.0f);
+        for(int c=0 ; c<inputs ; c++)
+            for(int i=0 ; i<frames ; i++) { out[0][i] += in[c][i]; }
+    }
+};
+
+static double time_callbacks(int workers, int chains, int stages, int frames)
+{
+    std::vector<Cascade> cascades(chains, Cascade(stages));
+    Mix left((chains + 1) / 2), right(chains / 2);
+
+    Graph graph;
+    graph.input_channels = 2;
+    graph.output_channels = 2;
+    graph.max_frames = frames;
+    graph.workers = workers;
+    graph.pin_workers = false;
+
+    int l = graph.add(&left);
+    int r = graph.add(&right);
+    for(int c=0 ; c<chains ; c++)
+    {
+        int id = graph.add(&cascades[c]);
+        graph.connect({Graph::external, c % 2}, {id, 0});
+        graph.connect({id, 0}, {c % 2 ? r : l, c / 2});
+    }
+    graph.connect({l, 0}, {Graph::external, 0});
+    graph.connect({r, 0}, {Graph::external, 1});
+    graph.compile();
+
+    std::vector<float> input(frames * 2), output(frames * 2);
+    for(size_t i=0 ; i<input.size() ; i++) { input[i] = std::sin(0.01f * i); }
+
+    using clock = std::chrono::steady_clock;
+    for(int i=0 ; i<100 ; i++) { graph.on_audio(input.data(), output.data(), frames); }
+
+    // best of 5 runs, so a preempted run doesn't count
+    double best = 1e30;
+    for(int run=0 ; run<5 ; run++)
+    {
+        int const calls = 200;
+        auto start = clock::now();
+        for(int i=0 ; i<calls ; i++) { graph.on_audio(input.data(), output.data(), frames); }
+        std::chrono::duration<double, std::micro> t = clock::now() - start;
+        best = std::min(best, t.count() / calls);
+    }
+    return best;
+}
+
+int main(int argc, char ** argv)
+{
+    int chains = argc > 1 ? std::atoi(argv[1]) : 64;
+    int stages = argc > 2 ? std::atoi(argv[2]) : 16;
+    int frames = argc > 3 ? std::atoi(argv[3]) : 256;
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    int max_workers = argc > 4 ? std::atoi(argv[4]) : cores - 1;
+
+    std::printf("%d chains x %d biquads, %d frames per callback\n", chains, stages, frames);
+    std::printf("%8s %14s %9s %14s\n", "workers", "us/callback", "speedup", "budget @48k");
+    double base = 0;
+    for(int workers=0 ; workers<=max_workers ; workers++)
+    {
+        double us = time_callbacks(workers, chains, stages, frames);
+        if(workers == 0) { base = us; }
+        double budget = frames * 1e6 / 48000;
+        std::printf("%8d %14.1f %8.2fx %13.0f%%\n", workers, us, base / us, 100 * us / budget);
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+// Meter::process cost per channel, for the channel counts of common layouts
+// peak / rms, 4x true peak and K-weighted loudness all run on every sample
+//
+// usage: meter_bench [frames per call]
+
+#include "audioplus/meter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace audioplus;
+
+int main(int argc, char ** argv)
+{
+    int frames = argc > 1 ? std::atoi(argv[1]) : 256;
+    double const rate = 48000;
+    int const seconds = 20;
+
+    std::printf("%d frames per call, %d s of audio per run\n", frames, seconds);
+    std::printf("%8s %14s %16s\n", "channels", "ns/frame/ch", "cpu @48k per ch");
+    for(int channels : {1, 2, 6, 8, 16})
+    {
+        std::vector<float> x(size_t(frames) * channels);
+        for(size_t i=0 ; i<x.size() ; i++) { x[i] = 0.5f * std::sin(0.0123f * i); }
+
+        Meter meter(channels, rate);
+        int calls = int(seconds * rate / frames);
+        using clock = std::chrono::steady_clock;
+        double best = 1e30;
+        for(int run=0 ; run<5 ; run++)
+        {
+            auto start = clock::now();
+            for(int i=0 ; i<calls ; i++) { meter.process(x.data(), frames); }
+            std::chrono::duration<double> t = clock::now() - start;
+            best = std::min(best, t.count());
+        }
+        double per_sample = best / (double(calls) * frames * channels);
+        std::printf("%8d %14.2f %15.3f%%\n", channels, 1e9 * per_sample, 100 * per_sample * rate);
+    }
+    return 0;
+}
@@ -0,0 +1,193 @@
+// 24 bit pcm conversion, WavStream against dr_wav's scalar readers, and
+// against scalar packing into drwav_write_pcm_frames for writes (dr_wav
+// has no float / int32 to 24 bit conversion of its own)
+// both sides move 256 frame chunks through the same iostream callbacks,
+// so the difference is the sample conversion
+//
+// usage: wav24_bench [seconds]
+
+#include "audioplus/wav.h"
+#include "dr_wav.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace audioplus;
+
+static constexpr int channels = 2;
+static constexpr int chunk = 256;
+
+static size_t on_read(void * ctx, void * buf, size_t count)
+{
+    std::istream * in = (std::istream *)ctx;
+    in->read((char *)buf, count);
+    return in->gcount();
+}
+
+static drwav_bool32 on_seek(void * ctx, int offset, drwav_seek_origin origin)
+{
+    std::istream * in = (std::istream *)ctx;
+    in->seekg(offset, origin == drwav_seek_origin_start ? std::ios_base::beg : std::ios_base::cur);
+    return !in->fail();
+}
+
+static size_t on_write(void * ctx, void const* buf, size_t count)
+{
+    std::ostream * out = (std::ostream *)ctx;
+    out->write((char const*)buf, count);
+    return out->good() ? count : 0;
+}
+
+static drwav_bool32 on_seek_out(void * ctx, int offset, drwav_seek_origin origin)
+{
+    std::ostream * out = (std::ostream *)ctx;
+    out->seekp(offset, origin == drwav_seek_origin_start ? std::ios_base::beg : std::ios_base::cur);
+    return !out->fail();
+}
+
+// one sample at a time, same rounding and clipping as WavStream
+static void pack24_scalar(float const* src, uint8_t * dst, int n)
+{
+    for(int i=0 ; i<n ; i++)
+    {
+        float x = std::min(std::max(src[i], -1.0f), 8388607.0f / 8388608.0f);
+        int32_t v = int32_t(std::lrint(x * 8388608.0f));
+        dst[3*i] = uint8_t(v);
+        dst[3*i + 1] = uint8_t(v >> 8);
+        dst[3*i + 2] = uint8_t(v >> 16);
+    }
+}
+
+static void pack24_scalar(int32_t const* src, uint8_t * dst, int n)
+{
+    for(int i=0 ; i<n ; i++)
+    {
+        dst[3*i] = uint8_t(src[i] >> 8);
+        dst[3*i + 1] = uint8_t(src[i] >> 16);
+        dst[3*i + 2] = uint8_t(src[i] >> 24);
+    }
+}
+
+template<class F>
+static double best_of(F run)
+{
+    using clock = std::chrono::steady_clock;
+    double best = 1e30;
+    for(int i=0 ; i<5 ; i++)
+    {
+        auto start = clock::now();
+        run();
+        std::chrono::duration<double> t = clock::now() - start;
+        best = std::min(best, t.count());
+    }
+    return best;
+}
+
+template<class T>
+static double read_audioplus(std::string const& bytes)
+{
+    std::vector<T> buf(chunk * channels);
+    return best_of([&]
+    {
+        std::istringstream in(bytes);
+        auto wav = make_wav_stream(in);
+        WavHeader header;
+        wav.read(&header);
+        while(wav.read(buf.data(), int(buf.size())) > 0) {}
+    });
+}
+
+template<class T, class Read>
+static double read_drwav(std::string const& bytes, Read read)
+{
+    std::vector<T> buf(chunk * channels);
+    return best_of([&]
+    {
+        std::istringstream in(bytes);
+        drwav wav;
+        drwav_init(&wav, on_read, on_seek, &in, nullptr);
+        while(read(&wav, chunk, buf.data()) > 0) {}
+        drwav_uninit(&wav);
+    });
+}
+
+template<class T>
+static double write_audioplus(std::vector<T> const& x, int frames, std::string * bytes)
+{
+    return best_of([&]
+    {
+        std::ostringstream out;
+        {
+            auto wav = make_wav_stream(out);
+            WavHeader header {48000, channels, frames, WavHeader::Int24};
+            wav.write(&header);
+            for(int i=0 ; i<frames ; i+=chunk)
+            {
+                int n = std::min(chunk, frames - i) * channels;
+                wav.write(x.data() + size_t(i) * channels, n);
+            }
+        }
+        if(bytes) { *bytes = out.str(); }
+    });
+}
+
+template<class T>
+static double write_drwav(std::vector<T> const& x, int frames)
+{
+    std::vector<uint8_t> raw(chunk * channels * 3);
+    return best_of([&]
+    {
+        std::ostringstream out;
+        drwav_data_format format;
+        format.container = drwav_container_riff;
+        format.format = DR_WAVE_FORMAT_PCM;
+        format.channels = channels;
+        format.sampleRate = 48000;
+        format.bitsPerSample = 24;
+        drwav wav;
+        drwav_init_write(&wav, &format, on_write, on_seek_out, &out, nullptr);
+        for(int i=0 ; i<frames ; i+=chunk)
+        {
+            int n = std::min(chunk, frames - i);
+            pack24_scalar(x.data() + size_t(i) * channels, raw.data(), n * channels);
+            drwav_write_pcm_frames(&wav, n, raw.data());
+        }
+        drwav_uninit(&wav);
+    });
+}
+
+int main(int argc, char ** argv)
+{
+    double seconds = argc > 1 ? std::atof(argv[1]) : 60;
+    int frames = int(seconds * 48000);
+    double samples = double(frames) * channels;
+
+    std::vector<float> x(size_t(frames) * channels);
+    for(size_t i=0 ; i<x.size() ; i++) { x[i] = 0.9f * std::sin(0.001f * i); }
+    std::vector<int32_t> xi(x.size());
+    for(size_t i=0 ; i<x.size() ; i++) { xi[i] = int32_t(x[i] * 2147483647.0f); }
+
+    std::string bytes;
+    double write = write_audioplus(x, frames, &bytes);
+
+    auto report = [&](char const* name, double t)
+    {
+        std::printf("%-28s %8.2f ns/sample %8.1f Msamples/s\n", name, 1e9 * t / samples, samples / t / 1e6);
+    };
+    std::printf("%.0f s stereo 24 bit, %d frame chunks\n", seconds, chunk);
+    report("float read   dr_wav", read_drwav<float>(bytes, drwav_read_pcm_frames_f32));
+    report("float read   audioplus", read_audioplus<float>(bytes));
+    report("int32 read   dr_wav", read_drwav<drwav_int32>(bytes, drwav_read_pcm_frames_s32));
+    report("int32 read   audioplus", read_audioplus<int32_t>(bytes));
+    report("float write  dr_wav", write_drwav(x, frames));
+    report("float write  audioplus", write);
+    report("int32 write  dr_wav", write_drwav(xi, frames));
+    report("int32 write  audioplus", write_audioplus(xi, frames, nullptr));
+    return 0;
+}
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <string>
+#include <memory>
+#include <type_traits>
+
+#include "audioplus/scratch.h"
+#include "audioplus/thread.h"
 
 struct PaStreamCallbackTimeInfo;
 
@@ -9,6 +14,10 @@ namespace audioplus {
 template<class T>
 uint32_t get_audio_dtype();
 
+// get_audio_dtype<void>(), open() picks the format the device runs natively
+// and writes it back to the config, the callback gets raw bytes
+constexpr uint32_t native_dtype = 0x40000000;
+
 struct AudioDevice
 {
     int index;
@@ -16,6 +25,10 @@ struct AudioDevice
     int max_input_channels() const;
     int max_output_channels() const;
     double default_sample_rate() const;
+    double default_low_input_latency() const; // seconds
+    double default_low_output_latency() const;
+    double default_high_input_latency() const;
+    double default_high_output_latency() const;
 };
 
 struct AudioStream
@@ -30,10 +43,17 @@ struct AudioStream
         bool output_underflow = 0;
         bool output_overflow = 0;
         bool priming_output = 0;
+        // per-callback arena, reset before each callback
+        // nullptr unless Config::scratch_buffers > 0
+        Scratch * scratch = nullptr;
         Status() {}
         Status(PaStreamCallbackTimeInfo const* pa_time, unsigned long pa_flags);
     };
 
+    // what on_audio_fn points to, ctx = on_audio_ctx
+    using Callback = int(*)(void const* input, void * output, int frames,
+        Status const& status, void * ctx);
+
     struct Config
     {
         void * on_audio_fn = nullptr;
@@ -47,7 +67,46 @@ struct AudioStream
         AudioDevice input_device = {-1}; // -1 = default
         AudioDevice output_device = {-1}; // -1 = default
         double sample_rate = 0;
+        // 0 = derived from latency
+        // auto_chunk = smallest size that survives a calibration run
+        // calibration streams are muted and spin calibrate_load_ns per
+        // frame in place of on_audio
         int chunk_frames = 0;
+        static constexpr int auto_chunk = -1;
+        int calibrate_ms = 250; // per candidate size, auto_chunk only
+        int calibrate_min_frames = 16; // smallest candidate tried
+        double calibrate_load_ns = 0; // synthetic callback cost per frame
+        // run the real on_audio instead, its state advances on audio that
+        // never plays; a non-zero return fails that size
+        bool calibrate_on_audio = false;
+        double input_latency = 0; // seconds, 0 = device default
+        double output_latency = 0; // seconds, 0 = device default
+        bool high_latency = false; // device defaults: high instead of low
+        int input_latency_frames = 0; // actual, filled by open()
+        int output_latency_frames = 0; // actual, filled by open()
+        // blocking mode: latency is raised so the host can buffer
+        // 2 transfers of this size while the consumer is busy
+        int batch_frames = 0;
+        // Status::scratch capacity, in chunk_frames x max(channels) floats
+        int scratch_buffers = 0;
+        bool scratch_strict = false; // abort instead of falling back to heap
+        // > 0: on_audio always sees exactly this many frames
+        int block_frames = 0;
+        int block_latency_frames = 0; // added by reblocking, filled by open()
+        // callback thread priority / core / stack, applied in the first callback
+        ThreadPolicy thread_policy;
+        bool lock_memory = false; // mlockall at open(), throws if not allowed
+        bool track_thread_stats = false; // sample thread_stats() every callback
+        // callback buffers are arrays of per channel pointers
+        // set by planar on_audio signatures, not usable with block_frames
+        bool non_interleaved = false;
+        // whether portaudio probably converts between dtype and the device
+        // format, filled by open(); portaudio doesn't report the device
+        // format, so this is a guess from the host api, not a fact
+        // false doesn't mean clip / dither are free, set them off
+        // explicitly if the callback already delivers the final samples
+        bool likely_input_conversion = false;
+        bool likely_output_conversion = false;
         bool clip = true;
         bool dither = true;
         bool never_drop_input = false;
@@ -56,6 +115,17 @@ struct AudioStream
         template<class Obj>
         void on_audio(Obj * obj) { on_audio(obj, &Obj::on_audio); }
 
+        // no callback, use stream.read() / stream.write() instead
+        // with non_interleaved they take an array of channel pointers
+        template<class TIn, class TOut = TIn>
+        void blocking()
+        {
+            on_audio_fn = nullptr;
+            on_audio_ctx = nullptr;
+            input_dtype = get_audio_dtype<TIn>();
+            output_dtype = get_audio_dtype<TOut>();
+        }
+
         template<class Obj>
         void on_finish(Obj * obj)
         { 
@@ -70,44 +140,72 @@ struct AudioStream
         void on_audio(Obj * obj, int(Obj::*)(T1 const*, T2*, int, Status const&))
         {
             on_audio_ctx = obj;
-            on_audio_fn = (void *) +[] (
-                void const* i, void * o,
-                unsigned long n,
-                PaStreamCallbackTimeInfo const* pa_time,
-                unsigned long pa_flags,
-                void * pa_ctx)
+            on_audio_fn = (void *) (Callback) +[] (
+                void const* i, void * o, int n,
+                Status const& status, void * ctx)
             {
-                Status status(pa_time, pa_flags);
-                return ((Obj *)pa_ctx)->on_audio((T1 const*)i, (T2 *)o, n, status);
+                return ((Obj *)ctx)->on_audio((T1 const*)i, (T2 *)o, n, status);
             };
             input_dtype = get_audio_dtype<T1>();
             output_dtype = get_audio_dtype<T2>();
+            non_interleaved = false;
         }
         template<class Obj, class T1, class T2>
         void on_audio(Obj * obj, int(Obj::*)(T1 const*, T2*, int))
         {
             on_audio_ctx = obj;
-            on_audio_fn = (void *) +[] (
-                void const* i, void * o,
-                unsigned long n,
-                PaStreamCallbackTimeInfo const* /*time*/,
-                unsigned long /*pa_status*/,
-                void * pa_ctx)
+            on_audio_fn = (void *) (Callback) +[] (
+                void const* i, void * o, int n,
+                Status const& /*status*/, void * ctx)
+            {
+                return ((Obj *)ctx)->on_audio((T1 const*)i, (T2 *)o, n);
+            };
+            input_dtype = get_audio_dtype<T1>();
+            output_dtype = get_audio_dtype<T2>();
+            non_interleaved = false;
+        }
+        // planar, in[c] / out[c] are the device's channel buffers
+        template<class Obj, class T1, class T2>
+        void on_audio(Obj * obj, int(Obj::*)(T1 const* const*, T2 * const*, int, Status const&))
+        {
+            on_audio_ctx = obj;
+            on_audio_fn = (void *) (Callback) +[] (
+                void const* i, void * o, int n,
+                Status const& status, void * ctx)
+            {
+                return ((Obj *)ctx)->on_audio((T1 const* const*)i, (T2 * const*)o, n, status);
+            };
+            input_dtype = get_audio_dtype<T1>();
+            output_dtype = get_audio_dtype<T2>();
+            non_interleaved = true;
+        }
+        template<class Obj, class T1, class T2>
+        void on_audio(Obj * obj, int(Obj::*)(T1 const* const*, T2 * const*, int))
+        {
+            on_audio_ctx = obj;
+            on_audio_fn = (void *) (Callback) +[] (
+                void const* i, void * o, int n,
+                Status const& /*status*/, void * ctx)
             {
-                return ((Obj *)pa_ctx)->on_audio((T1 const*)i, (T2 *)o, n);
+                return ((Obj *)ctx)->on_audio((T1 const* const*)i, (T2 * const*)o, n);
             };
             input_dtype = get_audio_dtype<T1>();
             output_dtype = get_audio_dtype<T2>();
+            non_interleaved = true;
         }
     };
 
+    // state the callback sees, owned by the stream
+    struct Context;
+
     void * backend = nullptr;
+    std::unique_ptr<Context> context;
 
-    AudioStream() {}
+    AudioStream();
     AudioStream(AudioStream const&) = delete;
     AudioStream(AudioStream &&);
     AudioStream & operator=(AudioStream &&);
-    ~AudioStream() { close(std::nothrow_t{}); }
+    ~AudioStream();
 
     bool is_open() const;
     bool running() const;
@@ -117,6 +215,71 @@ struct AudioStream
     void close();
     int close(std::nothrow_t); // return < 0 if error
     double clock_time();
+    // delay added by Config::block_frames, grows if the host
+    // ever delivers a size that starves the output
+    int block_latency_frames() const;
+    // page faults / context switches on the callback thread since its
+    // first callback, needs Config::track_thread_stats
+    ThreadStats thread_stats() const;
+    // errno from applying Config::thread_policy, 0 if it worked
+    int thread_policy_error() const;
+    // times Status::scratch ran out and went to the heap, 0 without scratch
+    int scratch_fallbacks() const;
+
+    // DEVICE LOSS
+
+    // true if the host ended the stream on its own, a blocking transfer
+    // hit a device error, or a running callback stream got no callback
+    // for `stall` seconds
+    bool device_lost(double stall = 0.5) const;
+    // move this stream to other devices, -1 = current default
+    // keeps callback, context and config, restarts if it was running
+    // other streams are untouched, unlike AudioSession::restart()
+    // devices plugged in after the session started need a restart()
+    void reopen(AudioDevice input = {-1}, AudioDevice output = {-1});
+    // the config open() resolved, as used by reopen()
+    Config const& config() const;
+
+    // BLOCKING API (stream opened without on_audio)
+
+    // wait until all frames are transferred
+    // return false if an overflow / underflow happened meanwhile
+    // throws if T doesn't match the stream's resolved dtype
+    template<class T>
+    std::enable_if_t<!std::is_pointer_v<T>, bool> read(T * samples, int frames)
+    {
+        check_dtype(true, get_audio_dtype<T>(), false);
+        return read_raw(samples, frames);
+    }
+    template<class T>
+    std::enable_if_t<!std::is_pointer_v<T>, bool> write(T const* samples, int frames)
+    {
+        check_dtype(false, get_audio_dtype<T>(), false);
+        return write_raw(samples, frames);
+    }
+    // non_interleaved streams, one pointer per channel
+    template<class T>
+    bool read(T * const* channels, int frames)
+    {
+        check_dtype(true, get_audio_dtype<T>(), true);
+        return read_raw((void *)channels, frames);
+    }
+    template<class T>
+    bool write(T const* const* channels, int frames)
+    {
+        check_dtype(false, get_audio_dtype<T>(), true);
+        return write_raw((void const*)channels, frames);
+    }
+
+    // frames that can be transferred without waiting
+    int read_available();
+    int write_available();
+
+    // no type check, for native_dtype streams
+    bool read_raw(void * samples, int frames);
+    bool write_raw(void const* samples, int frames);
+
+    void check_dtype(bool input, uint32_t dtype, bool planar) const;
 };
 
 struct AudioSession
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "audioplus/wav.h"
+
+#include <vector>
+#include <memory>
+
+namespace audioplus {
+
+// partitioned FFT convolution for long impulse responses
+// the head of the IR runs in `block` sized partitions on the caller's
+// thread, so output has no delay beyond the block itself; the tail runs
+// in larger partitions on a background thread, a full tail block ahead
+struct Convolver
+{
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+
+    // ir[c] convolves input channel c
+    // tail_block = 0 picks a size balancing head and tail cost
+    Convolver(std::vector<std::vector<float>> const& ir, int block, int tail_block = 0);
+    Convolver(Convolver const&) = delete;
+    ~Convolver();
+
+    int channels() const;
+    int block() const;
+    int tail_block() const; // 0 if the IR fits in the head
+    int late_tail_blocks() const; // blocks output without tail, background thread was late
+    // frames output is delayed by, 0 until process() has to buffer
+    int latency() const;
+
+    // interleaved, realtime safe, in and out may alias
+    // multiples of block() go straight through with no added delay; the
+    // first call that isn't one switches to buffering partial blocks, and
+    // from then on output is latency() = block() - 1 frames late
+    void process(float const* in, float * out, int frames);
+};
+
+// read a whole wav into one float vector per channel, for Convolver
+template<class Stream>
+std::vector<std::vector<float>> read_impulse(WavStream<Stream> & wav)
+{
+    WavHeader header;
+    std::vector<float> samples;
+    if(wav.read(&header) < 0 || wav.read_all(samples) < 0) { return {}; }
+    int frames = samples.size() / header.channels;
+    std::vector<std::vector<float>> out(header.channels, std::vector<float>(frames));
+    for(int i=0 ; i<frames ; i++)
+    {
+        for(int c=0 ; c<header.channels ; c++)
+        {
+            out[c][i] = samples[size_t(i) * header.channels + c];
+        }
+    }
+    return out;
+}
+
+} // namespace audioplus
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+namespace audioplus {
+
+// std::streambuf over a file descriptor: pipe, socket, stdin / stdout
+// buffers `buffer_size` bytes per syscall, and transfers at least that
+// big go straight between the caller's memory and the descriptor
+// never seeks, so WavStream treats it as a stream of unknown length
+// a failed read() throws std::system_error, which the istream turns into
+// badbit, so it isn't mistaken for EOF; a failed write() sets badbit on
+// the ostream as usual; error() has the errno either way
+struct FdStreamBuf : std::streambuf
+{
+    static constexpr size_t default_buffer = 1 << 20;
+
+    FdStreamBuf(int fd, size_t buffer_size = default_buffer, bool owns_fd = false);
+    FdStreamBuf(FdStreamBuf const&) = delete;
+    ~FdStreamBuf(); // flushes, closes the fd if owned
+
+    int fd() const { return m_fd; }
+    int error() const { return m_error; } // errno of the failed read / write, 0 if none
+
+  protected:
+    int_type underflow() override;
+    std::streamsize xsgetn(char * s, std::streamsize n) override;
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(char const* s, std::streamsize n) override;
+    int sync() override;
+
+  private:
+    int m_fd;
+    bool m_owns_fd;
+    int m_error = 0;
+    size_t m_buffer_size;
+    std::vector<char> m_in;
+    std::vector<char> m_out;
+
+    bool flush_out();
+    [[noreturn]] void throw_error();
+};
+
+// read side, e.g. FdIStream in(0) for stdin
+struct FdIStream : std::istream
+{
+    FdStreamBuf m_buf;
+
+    FdIStream(int fd, size_t buffer_size = FdStreamBuf::default_buffer, bool owns_fd = false)
+    :   std::istream(nullptr),
+        m_buf(fd, buffer_size, owns_fd)
+    {
+        rdbuf(&m_buf);
+    }
+};
+
+// write side, e.g. FdOStream out(1) for stdout
+struct FdOStream : std::ostream
+{
+    FdStreamBuf m_buf;
+
+    FdOStream(int fd, size_t buffer_size = FdStreamBuf::default_buffer, bool owns_fd = false)
+    :   std::ostream(nullptr),
+        m_buf(fd, buffer_size, owns_fd)
+    {
+        rdbuf(&m_buf);
+    }
+};
+
+} // namespace audioplus
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <complex>
+
+namespace audioplus {
+
+// real FFT of a power of 2 size
+// spectra are split into real / imag arrays of size/2+1 bins,
+// which keeps spectral math in plain vectorizable loops
+struct Fft
+{
+    int m_size = 0;
+    // half size complex fft, split like the spectra so the butterflies
+    // vectorize; twiddles for each stage are contiguous, stage h at h-1
+    std::vector<float> m_twiddle_re, m_twiddle_im;
+    std::vector<std::complex<float>> m_post; // real <-> half size packing
+    std::vector<int> m_bitrev;
+    std::vector<float> m_work_re, m_work_im;
+
+    Fft() {}
+    Fft(int size);
+
+    int size() const { return m_size; }
+    int bins() const { return m_size / 2 + 1; }
+
+    // unnormalized
+    void forward(float const* in, float * re, float * im);
+    // scaled by 1/size, so inverse(forward(x)) == x
+    void inverse(float const* re, float const* im, float * out);
+};
+
+// acc += a * b over split complex arrays
+void complex_mac(float * acc_re, float * acc_im,
+    float const* a_re, float const* a_im,
+    float const* b_re, float const* b_im, int n);
+
+} // namespace audioplus
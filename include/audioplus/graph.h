@@ -0,0 +1,72 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace audioplus {
+
+// one processing step in a Graph
+// every port carries a mono float buffer of `frames` samples
+struct GraphNode
+{
+    int inputs = 0;
+    int outputs = 0;
+
+    GraphNode(int inputs = 0, int outputs = 0)
+    :   inputs(inputs), outputs(outputs)
+    {
+    }
+    virtual ~GraphNode() {}
+
+    // called from the audio thread or a graph worker, never concurrently
+    // unconnected inputs read silence, unconnected outputs are discarded
+    virtual void process(float const* const* in, float * const* out, int frames) = 0;
+};
+
+// DAG of GraphNodes, scheduled across worker threads on every callback
+// usable directly as AudioStream::Config::on_audio(&graph)
+struct Graph
+{
+    static constexpr int external = -1;
+
+    // node = external means a graph input (as source)
+    // or a graph output (as destination) channel
+    struct Port
+    {
+        int node = external;
+        int port = 0;
+    };
+
+    int input_channels = 0;
+    int output_channels = 0;
+    int max_frames = 1024; // longer callbacks are processed in pieces
+    int workers = 0; // helper threads besides the audio thread
+    // one core per worker, linux only
+    // priority and stack come from helper_thread_policy()
+    bool pin_workers = true;
+    int first_cpu = 1; // core for the first worker when pinned
+
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+
+    Graph();
+    Graph(Graph const&) = delete;
+    ~Graph();
+
+    // nodes are not owned, return node id
+    int add(GraphNode * node);
+
+    // each destination port has at most one source
+    void connect(Port src, Port dst);
+
+    // plan schedule and buffers, (re)start workers
+    // not realtime safe, call while the stream is stopped
+    void compile();
+
+    // number of distinct buffers the planner settled on
+    int buffer_count() const;
+
+    int on_audio(float const* input, float * output, int frames);
+};
+
+} // namespace audioplus
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace audioplus {
+
+struct MeterLevels
+{
+    // linear amplitude, full scale = 1
+    struct Channel
+    {
+        float peak = 0;
+        float rms = 0;
+        float true_peak = 0; // 4x oversampled, ITU-R BS.1770
+    };
+
+    std::vector<Channel> channels;
+    float momentary_lufs = -1e9f; // EBU R128, 400 ms window
+    float short_term_lufs = -1e9f; // EBU R128, 3 s window
+    uint64_t frame = 0; // frames processed at publish time
+};
+
+// level meter for interleaved float audio
+// process() belongs to the audio thread and never allocates or locks
+// read() belongs to one ui thread and never waits on the audio thread
+struct Meter
+{
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+
+    // peak / rms are published every `interval` seconds
+    Meter(int channels, double sample_rate, double interval = 0.05);
+    Meter(Meter const&) = delete;
+    ~Meter();
+
+    void process(float const* samples, int frames);
+
+    // latest published levels, valid until the next read()
+    MeterLevels const& read();
+};
+
+} // namespace audioplus
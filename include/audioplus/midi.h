@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <string>
 
 namespace audioplus {
@@ -39,6 +40,9 @@ struct MidiInputStream
         }
     };
 
+    Config config; // as resolved by open(), for reopen()
+    std::atomic<bool> lost {false}; // set by read(), polled from any thread
+
     MidiInputStream() {}
     MidiInputStream(MidiInputStream const&) = delete;
     MidiInputStream(MidiInputStream && o);
@@ -50,6 +54,12 @@ struct MidiInputStream
     int close(std::nothrow_t); // return < 0 if error
 
     int read(MidiMsg * buf, int buf_size);
+
+    // true once read() failed because the device went away
+    bool device_lost() const;
+    // move to another device with the same config, -1 = current default
+    // other streams are untouched, unlike MidiSession::restart()
+    void reopen(MidiDevice device = {-1});
 };
 
 struct MidiSession
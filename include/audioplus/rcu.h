@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+
+namespace audioplus {
+
+// swap whole objects into one realtime reader without locks or frees
+// the reader calls read() once per callback and may use the pointer
+// until its next read(); replaced objects are deleted on a background
+// thread once the reader has moved past them
+template<class T>
+struct Rcu
+{
+    std::atomic<T *> m_current {nullptr};
+    std::atomic<uint64_t> m_generation {0};
+    std::atomic<uint64_t> m_reader_generation {0};
+
+    std::mutex m_mutex;
+    std::vector<std::pair<uint64_t, std::unique_ptr<T>>> m_retired;
+
+    std::condition_variable m_wake;
+    bool m_quit = false;
+    std::thread m_reclaimer;
+
+    Rcu(std::unique_ptr<T> initial = {},
+        std::chrono::milliseconds interval = std::chrono::milliseconds(20))
+    :   m_current(initial.release())
+    {
+        if(interval.count() > 0)
+        {
+            m_reclaimer = std::thread([this, interval] { reclaim_loop(interval); });
+        }
+    }
+    Rcu(Rcu const&) = delete;
+    ~Rcu()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_wake.notify_one();
+        if(m_reclaimer.joinable()) { m_reclaimer.join(); }
+        delete m_current.load();
+    }
+
+    // READER (audio thread)
+
+    T * read()
+    {
+        uint64_t gen = m_generation.load(std::memory_order_acquire);
+        T * obj = m_current.load(std::memory_order_acquire);
+        m_reader_generation.store(gen, std::memory_order_release);
+        return obj;
+    }
+
+    // WRITERS (any non realtime thread)
+
+    void publish(std::unique_ptr<T> obj)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        T * old = m_current.exchange(obj.release(), std::memory_order_acq_rel);
+        uint64_t gen = m_generation.fetch_add(1, std::memory_order_release) + 1;
+        if(old) { m_retired.emplace_back(gen, std::unique_ptr<T>(old)); }
+    }
+
+    // delete retired objects the reader can no longer hold
+    // the background thread does this, calling it directly is optional
+    void collect()
+    {
+        std::vector<std::unique_ptr<T>> dead;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            uint64_t seen = m_reader_generation.load(std::memory_order_acquire);
+            auto keep = m_retired.begin();
+            for(auto & r : m_retired)
+            {
+                if(r.first <= seen) { dead.push_back(std::move(r.second)); }
+                else { *keep++ = std::move(r); }
+            }
+            m_retired.erase(keep, m_retired.end());
+        }
+        // destructors run outside the lock
+    }
+
+    void reclaim_loop(std::chrono::milliseconds interval)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(!m_quit)
+        {
+            m_wake.wait_for(lock, interval);
+            lock.unlock();
+            collect();
+            lock.lock();
+        }
+    }
+};
+
+} // namespace audioplus
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <new>
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+namespace audioplus {
+
+// monotonic arena for temporaries inside one audio callback
+// the stream resets it before every callback, so nothing is freed by hand
+// running out falls back to the heap (counted), or aborts if strict:
+// an exception can't unwind through the host's C callback
+struct Scratch
+{
+    static constexpr size_t simd_align = 64;
+
+    struct Fallback
+    {
+        Fallback * next;
+        size_t align;
+    };
+
+    std::unique_ptr<char[]> m_buf;
+    char * m_begin = nullptr; // m_buf rounded up to simd_align
+    size_t m_size = 0;
+    size_t m_used = 0;
+    // written by the audio thread only, readable from any thread
+    std::atomic<size_t> m_high_water {0};
+    std::atomic<int> m_fallbacks {0};
+    bool m_strict = false;
+    Fallback * m_heap = nullptr;
+
+    Scratch() {}
+    Scratch(size_t bytes, bool strict = false)
+    :   m_buf(new char[bytes + simd_align]()), // zeroed, so pages are touched
+        m_size(bytes),
+        m_strict(strict)
+    {
+        uintptr_t base = (uintptr_t)m_buf.get();
+        m_begin = (char *)((base + simd_align - 1) & ~(uintptr_t)(simd_align - 1));
+    }
+    Scratch(Scratch const&) = delete;
+    ~Scratch() { release_heap(); }
+
+    void * allocate(size_t bytes, size_t align = simd_align)
+    {
+        uintptr_t base = (uintptr_t)m_begin;
+        uintptr_t start = (base + m_used + align - 1) & ~(uintptr_t)(align - 1);
+        if(m_begin && start + bytes <= base + m_size)
+        {
+            m_used = start + bytes - base;
+            if(m_used > m_high_water.load(std::memory_order_relaxed))
+            {
+                m_high_water.store(m_used, std::memory_order_relaxed);
+            }
+            return (void *)start;
+        }
+        m_fallbacks.store(m_fallbacks.load(std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed);
+        if(m_strict)
+        {
+            std::fprintf(stderr, "audioplus: Scratch out of space in strict mode, "
+                "%zu of %zu bytes used, %zu more asked\n", m_used, m_size, bytes);
+            std::abort();
+        }
+        // header keeps the block aligned and links it for release at reset
+        if(align < alignof(Fallback)) { align = alignof(Fallback); }
+        size_t head = (sizeof(Fallback) + align - 1) & ~(align - 1);
+        char * block = (char *)::operator new(head + bytes, std::align_val_t(align));
+        Fallback * f = (Fallback *)block;
+        f->next = m_heap;
+        f->align = align;
+        m_heap = f;
+        return block + head;
+    }
+
+    template<class T>
+    T * allocate(size_t count, size_t align = simd_align)
+    {
+        return (T *)allocate(count * sizeof(T), align);
+    }
+
+    void reset()
+    {
+        m_used = 0;
+        if(m_heap) { release_heap(); }
+    }
+
+    size_t capacity() const { return m_size; }
+    // most bytes used in one callback
+    size_t high_water() const { return m_high_water.load(std::memory_order_relaxed); }
+    // heap allocations so far
+    int fallbacks() const { return m_fallbacks.load(std::memory_order_relaxed); }
+
+  private:
+    void release_heap()
+    {
+        while(m_heap)
+        {
+            Fallback * next = m_heap->next;
+            ::operator delete((void *)m_heap, std::align_val_t(m_heap->align));
+            m_heap = next;
+        }
+    }
+};
+
+} // namespace audioplus
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "audioplus/queue.h"
+#include "audioplus/wav.h"
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace audioplus {
+
+struct SpectrumFrame
+{
+    uint64_t frame = 0; // input position of the window start
+    std::vector<float> power; // size/2+1 bins, |X|^2
+    std::vector<float> mel; // Config::mel_bands, empty if 0
+};
+
+// short time fourier analysis of a mono mix
+// push() takes audio on the realtime thread, a worker thread does the
+// windowing and FFTs and publishes frames through `frames`
+struct Stft
+{
+    enum Window
+    {
+        Rect,
+        Hann,
+        Hamming,
+        Blackman,
+    };
+
+    struct Config
+    {
+        int size = 1024; // power of 2
+        int hop = 256;
+        Window window = Hann;
+        int mel_bands = 0; // at most size/2+1
+        double sample_rate = 48000; // for mel band edges
+        int channels = 1; // push() input, mixed down to mono
+    };
+
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+
+    // worker -> consumer, full queue drops the newest frames
+    Queue<SpectrumFrame, 64> frames;
+
+    Stft(Config const& cfg);
+    Stft(Stft const&) = delete;
+    ~Stft();
+
+    // realtime safe, interleaved Config::channels
+    // return frames accepted, fewer if the worker fell behind
+    int push(float const* samples, int count);
+
+    int dropped_frames() const; // spectrum frames lost to a full queue
+
+    // offline, whole signal at once, frames split across threads
+    // threads = 0 uses every core, `frames` is not touched
+    std::vector<SpectrumFrame> analyze(float const* mono, size_t count, int threads = 0) const;
+
+    template<class Stream>
+    std::vector<SpectrumFrame> analyze(WavStream<Stream> & wav, int threads = 0) const
+    {
+        WavHeader header;
+        std::vector<float> samples;
+        if(wav.read(&header) < 0 || wav.read_all(samples) < 0) { return {}; }
+        size_t frames = samples.size() / header.channels;
+        for(size_t i=0 ; i<frames ; i++)
+        {
+            float sum = 0;
+            for(int c=0 ; c<header.channels ; c++) { sum += samples[i * header.channels + c]; }
+            samples[i] = sum / header.channels;
+        }
+        return analyze(samples.data(), frames, threads);
+    }
+};
+
+} // namespace audioplus
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+namespace audioplus {
+
+struct ThreadPolicy
+{
+    int priority = 0; // SCHED_FIFO 1..99, 0 = leave scheduling alone
+    int cpu = -1; // pin to this core, -1 = any
+    size_t prefault_stack = 0; // bytes of stack to touch up front
+};
+
+// counters for the calling thread since it started
+struct ThreadStats
+{
+    long minor_faults = 0;
+    long major_faults = 0;
+    long voluntary_switches = 0;
+    long involuntary_switches = 0;
+};
+
+// policy for threads the library starts itself (graph workers,
+// convolver tails, stft workers), set before creating those objects
+ThreadPolicy & helper_thread_policy();
+
+// touch the stack so later deep calls don't page fault
+void prefault_stack(size_t bytes);
+
+// applies to the calling thread, return 0 or an errno value
+int apply_thread_policy(ThreadPolicy const& policy);
+
+// lock current and future pages in ram, return 0 or an errno value
+int lock_memory();
+
+ThreadStats current_thread_stats();
+
+} // namespace audioplus
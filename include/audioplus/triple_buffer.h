@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+
+namespace audioplus {
+
+// latest-value exchange between one writer and one reader
+// neither side ever waits, the reader just sees the newest commit
+template<class T>
+struct TripleBuffer
+{
+    static constexpr int fresh = 4; // set in m_middle when not yet read
+
+    T m_buf[3] {};
+    std::atomic<int> m_middle {1};
+    int m_back = 0;
+    int m_front = 2;
+
+    T & write_slot()
+    {
+        return m_buf[m_back];
+    }
+
+    void write_commit()
+    {
+        m_back = m_middle.exchange(m_back | fresh, std::memory_order_acq_rel) & 3;
+    }
+
+    bool read_ready()
+    {
+        return m_middle.load(std::memory_order_relaxed) & fresh;
+    }
+
+    // newest committed value, stays put until the next read_slot()
+    T & read_slot()
+    {
+        if(read_ready())
+        {
+            m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & 3;
+        }
+        return m_buf[m_front];
+    }
+};
+
+} // namespace audioplus
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
+#include <algorithm>
 #include <memory>
+#include <memory_resource>
 #include <istream>
 #include <ostream>
 
@@ -16,32 +19,54 @@ struct WavHeader
         Float32,
         Int32,
         Int16,
+        Int24,
     };
 
+    // frames = unknown_frames
+    // read: the file came from a stream, samples run until EOF
+    // write: header for a pipe / socket, claims the largest RIFF size
+    // and never seeks, readers stop at EOF
+    static constexpr int unknown_frames = -1;
+
     int sample_rate = 0;
     int channels = 0;
     int frames = 0;
     DType dtype = OTHER;
 };
 
+// one raw little endian 24 bit sample, as stored in the file
+struct Packed24
+{
+    uint8_t bytes[3];
+};
+
 struct WavStreamBase
 {
     struct Impl;
-    std::unique_ptr<Impl> m_impl;
+    struct ImplDelete { void operator()(Impl * impl) const; };
+    std::unique_ptr<Impl, ImplDelete> m_impl;
     char const* error_message = nullptr;
 
-    WavStreamBase();
+    // all decoder state (including dr_wav's own allocations) comes from here
+    // nullptr = global heap
+    // with an arena / pool resource, nothing touches the heap after
+    // the header is read or written, so sample io is realtime safe
+    std::pmr::memory_resource * m_memory = nullptr;
+
+    WavStreamBase(std::pmr::memory_resource * memory = nullptr);
     virtual ~WavStreamBase();
 
     int read(std::istream & stream, WavHeader * header);
     int read(std::istream & stream, float * samples, int count);
     int read(std::istream & stream, int16_t * samples, int count);
     int read(std::istream & stream, int32_t * samples, int count);
+    int read(std::istream & stream, Packed24 * samples, int count);
 
     int write(std::ostream & stream, WavHeader const* header);
     int write(std::ostream & stream, float const* samples, int count);
     int write(std::ostream & stream, int16_t const* samples, int count);
     int write(std::ostream & stream, int32_t const* samples, int count);
+    int write(std::ostream & stream, Packed24 const* samples, int count);
 
     void finish();
 };
@@ -52,8 +77,9 @@ struct WavStream : WavStreamBase
 {
     Stream m_stream;
 
-    WavStream(Stream stream = {})
-    :   m_stream(std::forward<Stream>(stream))
+    WavStream(Stream stream = {}, std::pmr::memory_resource * memory = nullptr)
+    :   WavStreamBase(memory),
+        m_stream(std::forward<Stream>(stream))
     {
     }
     ~WavStream()
@@ -90,6 +116,32 @@ struct WavStream : WavStreamBase
         return *this;
     }
 
+    // all remaining samples, also when header.frames = unknown_frames
+    // reads whole frames in bounded chunks until EOF, so long pipe streams
+    // can go past INT_MAX samples
+    // return # read, < 0 if error
+    template<class T>
+    int64_t read_all(std::vector<T> & samples)
+    {
+        WavHeader header;
+        if(read(&header) < 0) { return -1; }
+        int channels = std::max(header.channels, 1);
+        int chunk = std::max((1 << 20) / channels, 1) * channels;
+        samples.clear();
+        if(header.frames > 0) { samples.reserve(size_t(header.frames) * channels); }
+        int count = 0;
+        do
+        {
+            size_t done = samples.size();
+            samples.resize(done + chunk);
+            count = read(samples.data() + done, chunk);
+            samples.resize(done + std::max(count, 0));
+        }
+        while(count > 0);
+        return count < 0 ? count : int64_t(samples.size());
+    }
+
+    // only ever shrinks the vector, so it never allocates
     template<class T>
     WavStream & operator>>(std::vector<T> & samples)
     {
@@ -143,9 +195,10 @@ struct WavStream : WavStreamBase
 // c++11/14 convenience to construct WavStream deducing template param
 // lvalue streams are stored by reference, and rvalue by value
 template<class Stream>
-WavStream<Stream> make_wav_stream(Stream && stream)
+WavStream<Stream> make_wav_stream(Stream && stream,
+    std::pmr::memory_resource * memory = nullptr)
 {
-    return WavStream<Stream>(std::forward<Stream>(stream));
+    return WavStream<Stream>(std::forward<Stream>(stream), memory);
 }
 
 } // namespace audioplus
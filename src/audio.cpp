@@ -3,6 +3,14 @@
 #include "portaudio.h"
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <numeric>
+#include <vector>
 
 namespace {
 
@@ -25,6 +33,8 @@ template<>
 uint32_t get_audio_dtype<int32_t>() { return paInt32; }
 template<>
 uint32_t get_audio_dtype<int16_t>() { return paInt16; }
+template<>
+uint32_t get_audio_dtype<void>() { return native_dtype; }
 
 
 static PaDeviceInfo const* get_info(int index)
@@ -50,6 +60,22 @@ double AudioDevice::default_sample_rate() const
 {
     return get_info(index)->defaultSampleRate;
 }
+double AudioDevice::default_low_input_latency() const
+{
+    return get_info(index)->defaultLowInputLatency;
+}
+double AudioDevice::default_low_output_latency() const
+{
+    return get_info(index)->defaultLowOutputLatency;
+}
+double AudioDevice::default_high_input_latency() const
+{
+    return get_info(index)->defaultHighInputLatency;
+}
+double AudioDevice::default_high_output_latency() const
+{
+    return get_info(index)->defaultHighOutputLatency;
+}
 
 
 AudioSession::AudioSession()
@@ -82,72 +108,585 @@ AudioDevice AudioSession::default_output()
     return {Pa_GetDefaultOutputDevice()};
 }
 
-AudioStream AudioSession::open(AudioStream::Config & cfg)
+// host formats, most likely native first
+// portaudio doesn't expose the device format, so the order is a guess
+// from the host api, narrowed by what Pa_IsFormatSupported accepts
+static std::array<PaSampleFormat, 4> host_formats(int device)
 {
-    AudioStream out;
+    PaHostApiInfo const* api = Pa_GetHostApiInfo(get_info(device)->hostApi);
+    switch(api ? api->type : paInDevelopment)
+    {
+    case paCoreAudio:
+    case paJACK:
+    case paWASAPI:
+        return {paFloat32, paInt32, paInt24, paInt16};
+    case paASIO:
+    case paALSA:
+    case paWDMKS:
+        return {paInt32, paInt24, paInt16, paFloat32};
+    default:
+        return {paInt16, paInt32, paInt24, paFloat32};
+    }
+}
 
-    if(cfg.input_channels == 0 && cfg.output_channels == 0)
-        throw std::runtime_error("AudioStream with no channels");
+// resolve native_dtype, return true if portaudio probably has to convert
+// Pa_IsFormatSupported also accepts formats it converts, so "supported"
+// only narrows the per host guess
+static bool negotiate_format(PaStreamParameters & p, bool input,
+    double sample_rate, uint32_t & dtype)
+{
+    PaSampleFormat planar = p.sampleFormat & paNonInterleaved;
+    PaSampleFormat best = 0;
+    for(PaSampleFormat f : host_formats(p.device))
+    {
+        p.sampleFormat = f | planar;
+        if(Pa_IsFormatSupported(input ? &p : nullptr, input ? nullptr : &p,
+            sample_rate) == paFormatIsSupported)
+        {
+            best = f;
+            break;
+        }
+    }
+    if(dtype == native_dtype) { dtype = best ? best : paFloat32; }
+    p.sampleFormat = dtype | planar;
+    return dtype != best;
+}
 
-    if(cfg.input_device.index < 0)
-        cfg.input_device.index = Pa_GetDefaultInputDevice();
+struct Calibration
+{
+    AudioStream::Context * ctx = nullptr; // user callback if calibrate_on_audio
+    double load_ns = 0; // per frame, without ctx
+    std::atomic<int> calls {0};
+    std::atomic<int> xruns {0};
+    std::atomic<bool> failed {false}; // the callback asked to stop
+    unsigned long out_frame_bytes = 0;
+    int out_channels = 0; // > 0 if planar
+};
 
-    if(cfg.output_device.index < 0)
-        cfg.output_device.index = Pa_GetDefaultOutputDevice();
+// fifo of whole frames, any sample format
+struct FrameRing
+{
+    std::vector<char> buf;
+    int frame_bytes = 0;
+    int capacity = 0;
+    int head = 0;
+    int fill = 0;
 
-    if(cfg.sample_rate == 0 && cfg.input_channels > 0)
-        cfg.sample_rate = cfg.input_device.default_sample_rate();
-    else if(cfg.sample_rate == 0)
-        cfg.sample_rate = cfg.output_device.default_sample_rate();
+    void init(int frames, int bytes)
+    {
+        buf.assign(size_t(frames) * bytes, 0);
+        frame_bytes = bytes;
+        capacity = frames;
+        head = fill = 0;
+    }
 
-    if(cfg.chunk_frames == 0)
-        cfg.chunk_frames = 512; // TODO device default latency)
+    void clear()
+    {
+        head = fill = 0;
+    }
+
+    template<class Copy>
+    void span(int start, int n, Copy copy)
+    {
+        int first = std::min(n, capacity - start);
+        copy(buf.data() + size_t(start) * frame_bytes, 0, first);
+        if(first < n) { copy(buf.data(), first, n - first); }
+    }
+
+    // open() sizes the rings so this never overflows, an overflow is a
+    // bug there; release builds drop the excess instead of corrupting
+    void write(void const* src, int n)
+    {
+        assert(n <= capacity - fill && "FrameRing overflow");
+        n = std::min(n, capacity - fill);
+        span((head + fill) % capacity, n, [&] (char * p, int off, int len) {
+            if(src) { std::memcpy(p, (char const*)src + size_t(off) * frame_bytes, size_t(len) * frame_bytes); }
+            else { std::memset(p, 0, size_t(len) * frame_bytes); }
+        });
+        fill += n;
+    }
+
+    void read(void * dst, int n)
+    {
+        span(head, n, [&] (char * p, int off, int len) {
+            std::memcpy((char *)dst + size_t(off) * frame_bytes, p, size_t(len) * frame_bytes);
+        });
+        head = (head + n) % capacity;
+        fill -= n;
+    }
+};
+
+// turns whatever the host delivers into fixed size blocks
+// output is delayed by `latency` frames, the least that keeps it
+// fed when every callback has chunk_frames
+struct Reblock
+{
+    int block = 0;
+    int slice = 0; // longest host run handled in one pass
+    std::atomic<int> latency {0}; // only the callback grows it, any thread reads
+    bool has_input = false;
+    bool has_output = false;
+    FrameRing in, out;
+    std::vector<char> in_block, out_block;
+
+    // drop what's queued, keep the delay the output has settled on
+    void reset()
+    {
+        in.clear();
+        out.clear();
+        out.write(nullptr, latency.load(std::memory_order_relaxed));
+    }
+};
+
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct AudioStream::Context
+{
+    AudioStream::Config config; // resolved, for reopen()
+    AudioStream::Callback on_audio_fn = nullptr;
+    void * on_audio_ctx = nullptr;
+    std::unique_ptr<Scratch> scratch;
+    std::unique_ptr<Reblock> reblock;
+
+    ThreadPolicy policy;
+    bool started = false;
+    std::atomic<int> policy_error {0};
+    bool track_stats = false;
+    ThreadStats baseline;
+    std::atomic<long> stats[4] {};
+
+    // device loss detection
+    std::atomic<bool> running {false}; // between start() and stop()
+    std::atomic<bool> stopping {false};
+    std::atomic<bool> ended {false}; // callback returned paComplete / paAbort
+    std::atomic<bool> lost {false};
+    std::atomic<int64_t> last_callback {0};
+
+    void reset_state()
+    {
+        started = false;
+        stopping = false;
+        ended = false;
+        lost = false;
+        last_callback = now_ns();
+        if(reblock) { reblock->reset(); }
+    }
+
+    void first_callback()
+    {
+        started = true;
+        policy_error.store(apply_thread_policy(policy), std::memory_order_relaxed);
+        if(track_stats) { baseline = current_thread_stats(); }
+    }
+
+    void sample_stats()
+    {
+        ThreadStats now = current_thread_stats();
+        stats[0].store(now.minor_faults - baseline.minor_faults, std::memory_order_relaxed);
+        stats[1].store(now.major_faults - baseline.major_faults, std::memory_order_relaxed);
+        stats[2].store(now.voluntary_switches - baseline.voluntary_switches, std::memory_order_relaxed);
+        stats[3].store(now.involuntary_switches - baseline.involuntary_switches, std::memory_order_relaxed);
+    }
+
+    int call(void const* input, void * output, int frames, Status & status)
+    {
+        if(scratch) { scratch->reset(); }
+        return on_audio_fn(input, output, frames, status, on_audio_ctx);
+    }
+};
+
+static int reblock_callback(AudioStream::Context & c,
+    char const* input, char * output, int frames, AudioStream::Status & status)
+{
+    Reblock & r = *c.reblock;
+    int in_bytes = r.in.frame_bytes;
+    int out_bytes = r.out.frame_bytes;
+    int result = paContinue;
+
+    // zero copy: host buffer is a whole number of blocks and nothing is queued
+    if(frames % r.block == 0 && r.in.fill == 0 && r.out.fill == 0)
+    {
+        for(int i=0 ; i<frames && result == paContinue ; i+=r.block)
+        {
+            result = c.call(
+                input ? input + size_t(i) * in_bytes : nullptr,
+                output ? output + size_t(i) * out_bytes : nullptr,
+                r.block, status);
+        }
+        return result;
+    }
+
+    while(frames > 0)
+    {
+        int n = std::min(frames, r.slice);
+
+        if(r.has_input)
+        {
+            r.in.write(input, n);
+            while(r.in.fill >= r.block && result == paContinue)
+            {
+                r.in.read(r.in_block.data(), r.block);
+                result = c.call(r.in_block.data(),
+                    r.has_output ? r.out_block.data() : nullptr,
+                    r.block, status);
+                if(r.has_output) { r.out.write(r.out_block.data(), r.block); }
+            }
+        }
+        else
+        {
+            // output only, blocks can be made on demand
+            while(r.out.fill < n && result == paContinue)
+            {
+                result = c.call(nullptr, r.out_block.data(), r.block, status);
+                r.out.write(r.out_block.data(), r.block);
+            }
+        }
+
+        if(r.has_output)
+        {
+            // irregular host size ran us dry, pad with silence
+            // and keep the extra delay so it doesn't happen again
+            int missing = std::max(0, n - r.out.fill);
+            r.out.read(output, n - missing);
+            std::memset(output + size_t(n - missing) * out_bytes, 0, size_t(missing) * out_bytes);
+            if(missing > 0)
+            {
+                r.latency.store(r.latency.load(std::memory_order_relaxed) + missing,
+                    std::memory_order_relaxed);
+            }
+            output += size_t(n) * out_bytes;
+        }
+        if(input) { input += size_t(n) * in_bytes; }
+        frames -= n;
+    }
+    return result;
+}
+
+// on_audio, through the reblocker if there is one
+static int run_callback(AudioStream::Context & c,
+    void const* input, void * output, unsigned long frames,
+    PaStreamCallbackTimeInfo const* pa_time, unsigned long pa_flags)
+{
+    AudioStream::Status status(pa_time, pa_flags);
+    status.scratch = c.scratch.get();
+    return c.reblock ?
+        reblock_callback(c, (char const*)input, (char *)output, frames, status) :
+        c.call(input, output, frames, status);
+}
+
+static int stream_callback(
+    void const* input, void * output,
+    unsigned long frames,
+    PaStreamCallbackTimeInfo const* pa_time,
+    unsigned long pa_flags,
+    void * ctx)
+{
+    AudioStream::Context * c = (AudioStream::Context *)ctx;
+    if(!c->started) { c->first_callback(); }
+    int result = run_callback(*c, input, output, frames, pa_time, pa_flags);
+    if(c->track_stats) { c->sample_stats(); }
+    c->last_callback.store(now_ns(), std::memory_order_relaxed);
+    if(result != paContinue) { c->ended = true; }
+    return result;
+}
+
+static int calibrate_callback(
+    void const* input, void * output,
+    unsigned long frames,
+    PaStreamCallbackTimeInfo const* pa_time,
+    unsigned long pa_flags,
+    void * ctx)
+{
+    Calibration * cal = (Calibration *)ctx;
+    constexpr unsigned long xrun_flags = paInputUnderflow
+        | paInputOverflow | paOutputUnderflow | paOutputOverflow;
+    if(pa_flags & xrun_flags) { cal->xruns++; }
+    cal->calls++;
+    // thread policy and stats belong to the real stream's thread, not this one
+    int result = paContinue;
+    if(cal->ctx) { result = run_callback(*cal->ctx, input, output, frames, pa_time, pa_flags); }
+    else
+    {
+        int64_t until = now_ns() + int64_t(cal->load_ns * frames);
+        while(now_ns() < until) {}
+    }
+    if(result != paContinue) { cal->failed = true; }
+    if(output && cal->out_channels)
+    {
+        for(int c=0 ; c<cal->out_channels ; c++)
+        {
+            std::memset(((void **)output)[c], 0, frames * cal->out_frame_bytes);
+        }
+    }
+    else if(output) { std::memset(output, 0, frames * cal->out_frame_bytes); }
+    return result;
+}
+
+// callback state for a config with its final chunk size
+static void init_context(AudioStream::Context & ctx, AudioStream::Config & cfg)
+{
+    ctx.on_audio_fn = (AudioStream::Callback)cfg.on_audio_fn;
+    ctx.on_audio_ctx = cfg.on_audio_ctx;
+    ctx.policy = cfg.thread_policy;
+    ctx.track_stats = cfg.track_thread_stats;
+
+    if(cfg.block_frames > 0)
+    {
+        Reblock * r = new Reblock();
+        ctx.reblock.reset(r);
+        r->block = cfg.block_frames;
+        r->slice = std::max(cfg.chunk_frames, cfg.block_frames);
+        r->has_input = cfg.input_channels > 0;
+        r->has_output = cfg.output_channels > 0;
+        int in_bytes = r->has_input ? Pa_GetSampleSize(cfg.input_dtype) * cfg.input_channels : 0;
+        int out_bytes = r->has_output ? Pa_GetSampleSize(cfg.output_dtype) * cfg.output_channels : 0;
+        r->in.init(r->block + r->slice, in_bytes);
+        r->in_block.resize(size_t(r->block) * in_bytes);
+        // room for the worst case delay, plus a block and a slice in flight
+        r->out.init(2 * r->block + r->slice, out_bytes);
+        r->out_block.resize(size_t(r->block) * out_bytes);
+        if(r->has_input && r->has_output)
+        {
+            r->latency = r->block - std::gcd(r->block, cfg.chunk_frames);
+            r->out.write(nullptr, r->latency);
+        }
+        cfg.block_latency_frames = r->latency;
+    }
+
+    if(cfg.scratch_buffers > 0)
+    {
+        // each buffer padded so aligned allocations of a full chunk all fit
+        size_t channels = std::max(cfg.input_channels, cfg.output_channels);
+        size_t frames = std::max(cfg.chunk_frames, cfg.block_frames);
+        size_t buffer = frames * channels * sizeof(float) + Scratch::simd_align;
+        ctx.scratch.reset(new Scratch(cfg.scratch_buffers * buffer, cfg.scratch_strict));
+    }
+}
+
+// run each candidate with the output muted and keep the first without
+// xruns, or an early stop from on_audio
+static int calibrate_chunk_frames(
+    AudioStream::Config const& cfg,
+    PaStreamParameters const* in_params,
+    PaStreamParameters const* out_params,
+    PaStreamFlags pa_flags)
+{
+    int const candidates[] = {16, 32, 64, 128, 256, 512, 1024, 2048, 4096};
+    for(int chunk : candidates)
+    {
+        if(chunk < cfg.calibrate_min_frames) { continue; }
+        Calibration cal;
+        AudioStream::Config trial = cfg;
+        trial.chunk_frames = chunk;
+        AudioStream::Context ctx;
+        if(cfg.on_audio_fn && cfg.calibrate_on_audio)
+        {
+            init_context(ctx, trial);
+            cal.ctx = &ctx;
+        }
+        cal.load_ns = cfg.calibrate_load_ns;
+        if(out_params)
+        {
+            cal.out_frame_bytes = Pa_GetSampleSize(out_params->sampleFormat);
+            if(out_params->sampleFormat & paNonInterleaved)
+                cal.out_channels = out_params->channelCount;
+            else
+                cal.out_frame_bytes *= out_params->channelCount;
+        }
+        PaStream * stream = nullptr;
+        if(Pa_OpenStream(&stream, in_params, out_params, cfg.sample_rate,
+            chunk, pa_flags, calibrate_callback, &cal) != paNoError)
+        {
+            continue;
+        }
+        int err = Pa_StartStream(stream);
+        if(!err)
+        {
+            Pa_Sleep(cfg.calibrate_ms);
+            err = Pa_StopStream(stream);
+        }
+        Pa_CloseStream(stream);
+        if(!err && cal.calls > 0 && cal.xruns == 0 && !cal.failed)
+        {
+            return chunk;
+        }
+    }
+    throw std::runtime_error("no chunk size survived calibration");
+}
+
+// PortAudio parameters for a resolved config
+// negotiate = false keeps the dtypes as they are, each probe can open the
+// device (ALSA does), which reopen() can't afford
+static PaStreamFlags stream_params(AudioStream::Config & cfg,
+    PaStreamParameters & in_params, PaStreamParameters & out_params,
+    bool negotiate = true)
+{
+    PaSampleFormat planar = cfg.non_interleaved ? paNonInterleaved : 0;
 
-    PaStreamParameters in_params;
     in_params.device = cfg.input_device.index;
     in_params.channelCount = cfg.input_channels;
-    in_params.sampleFormat = cfg.input_dtype;
-    in_params.suggestedLatency = 0;
+    in_params.sampleFormat = cfg.input_dtype | planar;
+    in_params.suggestedLatency = cfg.input_latency;
     in_params.hostApiSpecificStreamInfo = nullptr;
 
-    PaStreamParameters out_params;
     out_params.device = cfg.output_device.index;
     out_params.channelCount = cfg.output_channels;
-    out_params.sampleFormat = cfg.output_dtype;
-    out_params.suggestedLatency = 0;
+    out_params.sampleFormat = cfg.output_dtype | planar;
+    out_params.suggestedLatency = cfg.output_latency;
     out_params.hostApiSpecificStreamInfo = nullptr;
-    
+
+    if(negotiate && cfg.input_channels)
+        cfg.likely_input_conversion = negotiate_format(in_params, true, cfg.sample_rate, cfg.input_dtype);
+
+    if(negotiate && cfg.output_channels)
+        cfg.likely_output_conversion = negotiate_format(out_params, false, cfg.sample_rate, cfg.output_dtype);
+
     PaStreamFlags pa_flags = 0;
     if(!cfg.clip) { pa_flags |= paClipOff; }
     if(!cfg.dither) { pa_flags |= paDitherOff; }
     if(cfg.never_drop_input) { pa_flags |= paNeverDropInput; }
     if(cfg.prime_output_with_callback) { pa_flags |= paPrimeOutputBuffersUsingStreamCallback; }
+    return pa_flags;
+}
 
+static void finished_callback(void * ctx)
+{
+    AudioStream::Context * c = (AudioStream::Context *)ctx;
+    // neither stop() / abort() nor the callback asked for this
+    if(!c->stopping && !c->ended) { c->lost = true; }
+    if(c->config.on_finish_fn)
+    {
+        ((void(*)(void *))c->config.on_finish_fn)(c->config.on_finish_ctx);
+    }
+}
+
+static PaStream * open_backend(AudioStream::Config & cfg, AudioStream::Context & ctx,
+    PaStreamParameters const& in_params, PaStreamParameters const& out_params,
+    PaStreamFlags pa_flags)
+{
+    PaStream * stream = nullptr;
     throw_pa_error( Pa_OpenStream(
-        &out.backend,
+        &stream,
         cfg.input_channels ? &in_params : nullptr,
         cfg.output_channels ? &out_params : nullptr,
         cfg.sample_rate,
         cfg.chunk_frames,
         pa_flags,
-        (PaStreamCallback *)cfg.on_audio_fn,
-        cfg.on_audio_ctx
+        cfg.on_audio_fn ? stream_callback : nullptr,
+        &ctx
     ) );
+    Pa_SetStreamFinishedCallback(stream, finished_callback);
+
+    PaStreamInfo const* info = Pa_GetStreamInfo(stream);
+    if(info)
+    {
+        cfg.input_latency_frames = int(info->inputLatency * cfg.sample_rate + 0.5);
+        cfg.output_latency_frames = int(info->outputLatency * cfg.sample_rate + 0.5);
+    }
+    return stream;
+}
+
+AudioStream AudioSession::open(AudioStream::Config & cfg)
+{
+    AudioStream out;
+
+    if(cfg.input_channels == 0 && cfg.output_channels == 0)
+        throw std::runtime_error("AudioStream with no channels");
+
+    if(cfg.non_interleaved && cfg.block_frames > 0)
+        throw std::runtime_error("block_frames needs interleaved buffers");
+
+    if(cfg.input_device.index < 0)
+        cfg.input_device.index = Pa_GetDefaultInputDevice();
+
+    if(cfg.output_device.index < 0)
+        cfg.output_device.index = Pa_GetDefaultOutputDevice();
+
+    if(cfg.sample_rate == 0 && cfg.input_channels > 0)
+        cfg.sample_rate = cfg.input_device.default_sample_rate();
+    else if(cfg.sample_rate == 0)
+        cfg.sample_rate = cfg.output_device.default_sample_rate();
+
+    if(cfg.input_latency == 0 && cfg.input_channels > 0)
+        cfg.input_latency = cfg.high_latency ?
+            cfg.input_device.default_high_input_latency() :
+            cfg.input_device.default_low_input_latency();
+
+    if(cfg.output_latency == 0 && cfg.output_channels > 0)
+        cfg.output_latency = cfg.high_latency ?
+            cfg.output_device.default_high_output_latency() :
+            cfg.output_device.default_low_output_latency();
+
+    if(!cfg.on_audio_fn && cfg.batch_frames > 0)
+    {
+        double batch = 2.0 * cfg.batch_frames / cfg.sample_rate;
+        cfg.input_latency = std::max(cfg.input_latency, batch);
+        cfg.output_latency = std::max(cfg.output_latency, batch);
+    }
+
+    if(!cfg.on_audio_fn && !cfg.input_dtype)
+        cfg.input_dtype = paFloat32;
+
+    if(!cfg.on_audio_fn && !cfg.output_dtype)
+        cfg.output_dtype = paFloat32;
+
+    PaStreamParameters in_params;
+    PaStreamParameters out_params;
+    PaStreamFlags pa_flags = stream_params(cfg, in_params, out_params);
+
+    if(cfg.chunk_frames == 0)
+    {
+        // largest power of 2 that fits in the suggested latency
+        double latency = std::max(cfg.input_latency, cfg.output_latency);
+        int target = std::max(16, int(latency * cfg.sample_rate));
+        cfg.chunk_frames = 16;
+        while(cfg.chunk_frames * 2 <= target) { cfg.chunk_frames *= 2; }
+    }
+
+    if(cfg.lock_memory && lock_memory() != 0)
+        throw std::runtime_error("could not lock memory");
+
+    if(cfg.chunk_frames == AudioStream::Config::auto_chunk)
+    {
+        cfg.chunk_frames = calibrate_chunk_frames(cfg,
+            cfg.input_channels ? &in_params : nullptr,
+            cfg.output_channels ? &out_params : nullptr,
+            pa_flags);
+    }
 
+    out.context.reset(new AudioStream::Context());
+    AudioStream::Context & ctx = *out.context;
+    init_context(ctx, cfg);
+
+    out.backend = open_backend(cfg, ctx, in_params, out_params, pa_flags);
+    ctx.config = cfg;
     return out;
 }
 
 
 
+AudioStream::AudioStream()
+{
+}
 AudioStream::AudioStream(AudioStream && o)
 {
     std::swap(backend, o.backend);
+    std::swap(context, o.context);
 }
 AudioStream & AudioStream::operator=(AudioStream && o)
 {
     std::swap(backend, o.backend);
+    std::swap(context, o.context);
     return *this;
 }
+AudioStream::~AudioStream()
+{
+    close(std::nothrow_t{});
+}
 
 bool AudioStream::is_open() const
 {
@@ -159,16 +698,74 @@ bool AudioStream::running() const
 }
 void AudioStream::start()
 {
+    if(context)
+    {
+        context->reset_state();
+        context->running = true;
+    }
     throw_pa_error( Pa_StartStream(backend) );
 }
 void AudioStream::stop()
 {
+    if(context)
+    {
+        context->stopping = true;
+        context->running = false;
+    }
     throw_pa_error( Pa_StopStream(backend) );
 }
 void AudioStream::abort()
 {
+    if(context)
+    {
+        context->stopping = true;
+        context->running = false;
+    }
     throw_pa_error( Pa_AbortStream(backend) );
 }
+bool AudioStream::device_lost(double stall) const
+{
+    if(!context) { return false; }
+    Context & c = *context;
+    if(c.lost) { return true; }
+    if(!c.running || !c.on_audio_fn || c.ended) { return false; }
+    // some hosts just stop calling back when the device goes away
+    int64_t last = c.last_callback.load(std::memory_order_relaxed);
+    return now_ns() - last > int64_t(stall * 1e9);
+}
+void AudioStream::reopen(AudioDevice input, AudioDevice output)
+{
+    if(!context) { throw std::runtime_error("reopen on a closed stream"); }
+    Context & c = *context;
+    AudioStream::Config & cfg = c.config;
+    bool was_running = c.running;
+
+    // the old device may be gone, errors closing it don't matter
+    if(backend)
+    {
+        c.stopping = true;
+        Pa_AbortStream(backend);
+        Pa_CloseStream(backend);
+        backend = nullptr;
+    }
+
+    cfg.input_device.index = input.index < 0 ? Pa_GetDefaultInputDevice() : input.index;
+    cfg.output_device.index = output.index < 0 ? Pa_GetDefaultOutputDevice() : output.index;
+
+    // same rate, chunk and dtype, the callback sees no difference
+    // the dtypes were resolved by open(), no format probing here
+    PaStreamParameters in_params;
+    PaStreamParameters out_params;
+    PaStreamFlags pa_flags = stream_params(cfg, in_params, out_params, false);
+    backend = open_backend(cfg, c, in_params, out_params, pa_flags);
+    c.reset_state();
+    if(was_running) { start(); }
+}
+AudioStream::Config const& AudioStream::config() const
+{
+    if(!context) { throw std::runtime_error("stream is closed"); }
+    return context->config;
+}
 void AudioStream::close()
 {
     throw_pa_error( close(std::nothrow_t{}) );
@@ -177,12 +774,79 @@ int AudioStream::close(std::nothrow_t)
 {
     int stat = backend ? Pa_CloseStream(backend) : 0;
     backend = nullptr;
+    context.reset(); // callback is done with it
     return stat;
 }
 double AudioStream::clock_time()
 {
     return backend ? Pa_GetStreamTime(backend) : 0;
 }
+int AudioStream::block_latency_frames() const
+{
+    return context && context->reblock ?
+        context->reblock->latency.load(std::memory_order_relaxed) : 0;
+}
+ThreadStats AudioStream::thread_stats() const
+{
+    ThreadStats out;
+    if(!context) { return out; }
+    out.minor_faults = context->stats[0].load(std::memory_order_relaxed);
+    out.major_faults = context->stats[1].load(std::memory_order_relaxed);
+    out.voluntary_switches = context->stats[2].load(std::memory_order_relaxed);
+    out.involuntary_switches = context->stats[3].load(std::memory_order_relaxed);
+    return out;
+}
+int AudioStream::thread_policy_error() const
+{
+    return context ? context->policy_error.load(std::memory_order_relaxed) : 0;
+}
+int AudioStream::scratch_fallbacks() const
+{
+    return context && context->scratch ? context->scratch->fallbacks() : 0;
+}
+static bool is_device_error(int err)
+{
+    return err == paDeviceUnavailable || err == paUnanticipatedHostError
+        || err == paTimedOut || err == paInternalError;
+}
+int AudioStream::read_available()
+{
+    long frames = Pa_GetStreamReadAvailable(backend);
+    throw_pa_error(frames < 0 ? frames : 0);
+    return frames;
+}
+int AudioStream::write_available()
+{
+    long frames = Pa_GetStreamWriteAvailable(backend);
+    throw_pa_error(frames < 0 ? frames : 0);
+    return frames;
+}
+void AudioStream::check_dtype(bool input, uint32_t dtype, bool planar) const
+{
+    Config const& cfg = config();
+    if(dtype != (input ? cfg.input_dtype : cfg.output_dtype))
+        throw std::runtime_error("sample type does not match the stream dtype");
+    if(planar != cfg.non_interleaved)
+        throw std::runtime_error(planar ?
+            "channel pointers given to an interleaved stream" :
+            "interleaved buffer given to a non_interleaved stream");
+}
+bool AudioStream::read_raw(void * samples, int frames)
+{
+    int err = Pa_ReadStream(backend, samples, frames);
+    if(err == paInputOverflowed) { return false; }
+    if(is_device_error(err) && context) { context->lost = true; }
+    throw_pa_error(err);
+    return true;
+}
+bool AudioStream::write_raw(void const* samples, int frames)
+{
+    int err = Pa_WriteStream(backend, samples, frames);
+    if(err == paOutputUnderflowed) { return false; }
+    if(is_device_error(err) && context) { context->lost = true; }
+    throw_pa_error(err);
+    return true;
+}
 
 AudioStream::Status::Status(
     PaStreamCallbackTimeInfo const* pa_time, 
@@ -0,0 +1,346 @@
+#include "audioplus/convolver.h"
+#include "audioplus/fft.h"
+#include "audioplus/thread.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace audioplus {
+
+// uniformly partitioned overlap-save over one IR segment
+struct Partitioned
+{
+    int part = 0;
+    int parts = 0;
+    int bins = 0;
+    Fft fft;
+    std::vector<float> h_re, h_im; // parts x bins
+    std::vector<float> x_re, x_im; // frequency delay line, parts x bins
+    int pos = 0;
+    std::vector<float> in2; // last 2 partitions of input
+    std::vector<float> acc_re, acc_im;
+    std::vector<float> out2;
+
+    void init(float const* h, int len, int size)
+    {
+        part = size;
+        parts = std::max(1, (len + part - 1) / part);
+        fft = Fft(2 * part);
+        bins = fft.bins();
+        h_re.assign(size_t(parts) * bins, 0.0f);
+        h_im.assign(size_t(parts) * bins, 0.0f);
+        x_re.assign(size_t(parts) * bins, 0.0f);
+        x_im.assign(size_t(parts) * bins, 0.0f);
+        in2.assign(2 * part, 0.0f);
+        acc_re.assign(bins, 0.0f);
+        acc_im.assign(bins, 0.0f);
+        out2.assign(2 * part, 0.0f);
+
+        std::vector<float> padded(2 * part);
+        for(int j=0 ; j<parts ; j++)
+        {
+            std::fill(padded.begin(), padded.end(), 0.0f);
+            int n = std::min(part, len - j * part);
+            if(n > 0) { std::copy(h + j * part, h + j * part + n, padded.begin()); }
+            fft.forward(padded.data(),
+                h_re.data() + size_t(j) * bins, h_im.data() + size_t(j) * bins);
+        }
+    }
+
+    // `part` samples in, `part` samples out
+    void process(float const* in, float * out)
+    {
+        std::memmove(in2.data(), in2.data() + part, part * sizeof(float));
+        std::memcpy(in2.data() + part, in, part * sizeof(float));
+        fft.forward(in2.data(),
+            x_re.data() + size_t(pos) * bins, x_im.data() + size_t(pos) * bins);
+
+        std::fill(acc_re.begin(), acc_re.end(), 0.0f);
+        std::fill(acc_im.begin(), acc_im.end(), 0.0f);
+        for(int j=0 ; j<parts ; j++)
+        {
+            size_t x = size_t((pos - j + parts) % parts) * bins;
+            size_t h = size_t(j) * bins;
+            complex_mac(acc_re.data(), acc_im.data(),
+                x_re.data() + x, x_im.data() + x,
+                h_re.data() + h, h_im.data() + h, bins);
+        }
+        pos = (pos + 1) % parts;
+
+        fft.inverse(acc_re.data(), acc_im.data(), out2.data());
+        std::memcpy(out, out2.data() + part, part * sizeof(float));
+    }
+};
+
+
+struct Convolver::Impl
+{
+    int channels = 0;
+    int block = 0;
+    int tail = 0; // tail partition size, 0 = no tail
+
+    std::vector<Partitioned> heads;
+    std::vector<Partitioned> tails;
+    std::vector<float> x, y; // deinterleaved block, channels x block
+
+    // tail handoff, 3 tail blocks per channel each way
+    // input block k is in slot k%3, its output lands 2 blocks later
+    // in_block / out_block say which input block a slot holds in full
+    static constexpr uint64_t none = ~uint64_t(0);
+    std::vector<float> tail_in, tail_out;
+    std::atomic<uint64_t> in_block[3] {{none}, {none}, {none}};
+    std::atomic<uint64_t> out_block[3] {{none}, {none}, {none}};
+    uint64_t frame = 0;
+    std::atomic<uint64_t> tail_in_blocks {0};
+    // block the worker is reading, the audio thread won't refill its slot
+    std::atomic<uint64_t> busy {none};
+    bool skip_in = false; // audio thread, this tail block's input is dropped
+    std::atomic<int> late {0};
+
+    // partial blocks, once a process() call wasn't a whole number of them
+    // output then runs block - 1 frames late, so a full block is always
+    // ready when the caller needs it; in_fill + out_fill stays block - 1
+    bool buffered = false;
+    std::vector<float> in_queue, out_queue; // interleaved, block / 2 blocks
+    int in_fill = 0;
+    int out_fill = 0;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool quit = false;
+    std::thread worker;
+
+    float * tail_slot(std::vector<float> & v, int c, uint64_t k)
+    {
+        return v.data() + (size_t(c) * 3 + k % 3) * tail;
+    }
+
+    void tail_loop()
+    {
+        uint64_t k = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while(!quit)
+        {
+            uint64_t ready = tail_in_blocks.load(std::memory_order_acquire);
+            if(k == ready)
+            {
+                // lost wakeups only cost the timeout
+                wake.wait_for(lock, std::chrono::milliseconds(1));
+                continue;
+            }
+            lock.unlock();
+            // too far behind, those slots are already overwritten
+            if(ready - k > 2) { k = ready - 1; }
+            // claim the slot, then check the audio thread hasn't moved on to
+            // refilling it (block k+3); seq_cst on both sides means at least
+            // one of us sees the other, and that one backs off
+            busy.store(k, std::memory_order_seq_cst);
+            if(tail_in_blocks.load(std::memory_order_seq_cst) - k <= 2
+                && in_block[k % 3].load(std::memory_order_acquire) == k)
+            {
+                for(int c=0 ; c<channels ; c++)
+                {
+                    tails[c].process(tail_slot(tail_in, c, k), tail_slot(tail_out, c, k + 2));
+                }
+                out_block[(k + 2) % 3].store(k, std::memory_order_release);
+            }
+            busy.store(none, std::memory_order_release);
+            k++;
+            lock.lock();
+        }
+    }
+
+    void process_block(float const* in, float * out)
+    {
+        for(int c=0 ; c<channels ; c++)
+        {
+            float * xc = x.data() + size_t(c) * block;
+            for(int i=0 ; i<block ; i++) { xc[i] = in[size_t(i) * channels + c]; }
+        }
+
+        uint64_t k = frame / std::max(tail, 1); // current tail block
+        int offset = tail ? frame % tail : 0;
+        if(tail && offset == 0)
+        {
+            // an overrunning worker still reads an older block from this slot
+            uint64_t reading = busy.load(std::memory_order_seq_cst);
+            skip_in = reading != none && (k - reading) % 3 == 0;
+        }
+        // block k needs the output of input block k-2
+        bool tail_ready = tail && k >= 2
+            && out_block[k % 3].load(std::memory_order_acquire) == k - 2;
+        if(tail && k >= 2 && !tail_ready) { late++; }
+
+        for(int c=0 ; c<channels ; c++)
+        {
+            float * xc = x.data() + size_t(c) * block;
+            float * yc = y.data() + size_t(c) * block;
+            heads[c].process(xc, yc);
+            if(tail && !skip_in)
+            {
+                std::memcpy(tail_slot(tail_in, c, k) + offset, xc, block * sizeof(float));
+            }
+            if(tail_ready)
+            {
+                float const* t = tail_slot(tail_out, c, k) + offset;
+                for(int i=0 ; i<block ; i++) { yc[i] += t[i]; }
+            }
+        }
+
+        for(int c=0 ; c<channels ; c++)
+        {
+            float const* yc = y.data() + size_t(c) * block;
+            for(int i=0 ; i<block ; i++) { out[size_t(i) * channels + c] = yc[i]; }
+        }
+
+        frame += block;
+        if(tail && frame % tail == 0)
+        {
+            if(!skip_in) { in_block[k % 3].store(k, std::memory_order_release); }
+            tail_in_blocks.store(k + 1, std::memory_order_seq_cst);
+            wake.notify_one();
+        }
+    }
+};
+
+
+Convolver::Convolver(std::vector<std::vector<float>> const& ir, int block, int tail_block)
+:   m_impl(new Impl())
+{
+    Impl & m = *m_impl;
+    if(ir.empty() || block <= 0 || (block & (block - 1)))
+        throw std::runtime_error("convolver needs channels and a power of 2 block");
+
+    size_t len = 0;
+    for(auto & h : ir) { len = std::max(len, h.size()); }
+
+    int tail = tail_block;
+    if(tail == 0)
+    {
+        // head costs ~2*tail/block and tail ~len/tail MACs per sample
+        double best = std::sqrt(len * block / 2.0);
+        tail = 4 * block;
+        while(tail < best && tail < 64 * block) { tail *= 2; }
+    }
+    if(tail < block || (tail % block) || (tail & (tail - 1)))
+        throw std::runtime_error("tail block must be a power of 2 multiple of block");
+    if(len <= size_t(2 * tail)) { tail = 0; }
+
+    m.channels = ir.size();
+    m.block = block;
+    m.tail = tail;
+    m.x.assign(size_t(m.channels) * block, 0.0f);
+    m.y.assign(size_t(m.channels) * block, 0.0f);
+    m.in_queue.assign(size_t(m.channels) * block, 0.0f);
+    m.out_queue.assign(size_t(m.channels) * 2 * block, 0.0f);
+    m.heads.resize(m.channels);
+    m.tails.resize(tail ? m.channels : 0);
+
+    // the tail starts 2 tail blocks in, giving the worker a whole block of slack
+    int head_len = tail ? 2 * tail : len;
+    for(int c=0 ; c<m.channels ; c++)
+    {
+        int n = ir[c].size();
+        m.heads[c].init(ir[c].data(), std::min(n, head_len), block);
+        if(tail)
+        {
+            m.tails[c].init(ir[c].data() + std::min(n, head_len),
+                std::max(0, n - head_len), tail);
+        }
+    }
+
+    if(tail)
+    {
+        m.tail_in.assign(size_t(m.channels) * 3 * tail, 0.0f);
+        m.tail_out.assign(size_t(m.channels) * 3 * tail, 0.0f);
+        ThreadPolicy policy = helper_thread_policy();
+        m.worker = std::thread([&m, policy] {
+            apply_thread_policy(policy);
+            m.tail_loop();
+        });
+    }
+}
+
+Convolver::~Convolver()
+{
+    Impl & m = *m_impl;
+    if(m.worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m.mutex);
+            m.quit = true;
+        }
+        m.wake.notify_one();
+        m.worker.join();
+    }
+}
+
+int Convolver::channels() const
+{
+    return m_impl->channels;
+}
+int Convolver::block() const
+{
+    return m_impl->block;
+}
+int Convolver::tail_block() const
+{
+    return m_impl->tail;
+}
+int Convolver::late_tail_blocks() const
+{
+    return m_impl->late.load(std::memory_order_relaxed);
+}
+int Convolver::latency() const
+{
+    return m_impl->buffered ? m_impl->block - 1 : 0;
+}
+
+void Convolver::process(float const* in, float * out, int frames)
+{
+    Impl & m = *m_impl;
+    if(!m.buffered && frames % m.block == 0)
+    {
+        for(int i=0 ; i<frames ; i+=m.block)
+        {
+            m.process_block(in + size_t(i) * m.channels, out + size_t(i) * m.channels);
+        }
+        return;
+    }
+    if(!m.buffered)
+    {
+        // out_queue is still silent
+        m.buffered = true;
+        m.out_fill = m.block - 1;
+    }
+
+    size_t ch = m.channels;
+    while(frames > 0)
+    {
+        int n = std::min(frames, m.block - m.in_fill);
+        std::memcpy(m.in_queue.data() + m.in_fill * ch, in, n * ch * sizeof(float));
+        m.in_fill += n;
+        if(m.in_fill == m.block)
+        {
+            m.process_block(m.in_queue.data(), m.out_queue.data() + m.out_fill * ch);
+            m.out_fill += m.block;
+            m.in_fill = 0;
+        }
+        // in was read above, so out may overwrite it
+        std::memcpy(out, m.out_queue.data(), n * ch * sizeof(float));
+        m.out_fill -= n;
+        std::memmove(m.out_queue.data(), m.out_queue.data() + n * ch,
+            m.out_fill * ch * sizeof(float));
+        in += n * ch;
+        out += n * ch;
+        frames -= n;
+    }
+}
+
+} // namespace audioplus
@@ -0,0 +1,191 @@
+#include "audioplus/fd_stream.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace audioplus {
+
+// return bytes read, 0 at eof, < 0 if error
+static long read_some(int fd, char * buf, size_t n)
+{
+    n = std::min(n, size_t(INT_MAX));
+#ifdef _WIN32
+    return _read(fd, buf, unsigned(n));
+#else
+    long got;
+    do { got = ::read(fd, buf, n); } while(got < 0 && errno == EINTR);
+    return got;
+#endif
+}
+
+// pipes and sockets take partial writes, keep going until all of it is out
+// a short count with error = errno if write() failed
+static size_t write_all(int fd, char const* buf, size_t n, int & error)
+{
+    size_t done = 0;
+    while(done < n)
+    {
+        size_t len = std::min(n - done, size_t(INT_MAX));
+#ifdef _WIN32
+        long wrote = _write(fd, buf + done, unsigned(len));
+#else
+        long wrote = ::write(fd, buf + done, len);
+        if(wrote < 0 && errno == EINTR) { continue; }
+#endif
+        if(wrote < 0) { error = errno; }
+        if(wrote <= 0) { break; }
+        done += wrote;
+    }
+    return done;
+}
+
+
+FdStreamBuf::FdStreamBuf(int fd, size_t buffer_size, bool owns_fd)
+:   m_fd(fd),
+    m_owns_fd(owns_fd),
+    m_buffer_size(std::max<size_t>(buffer_size, 1))
+{
+}
+
+FdStreamBuf::~FdStreamBuf()
+{
+    flush_out();
+    if(m_owns_fd)
+    {
+#ifdef _WIN32
+        _close(m_fd);
+#else
+        ::close(m_fd);
+#endif
+    }
+}
+
+bool FdStreamBuf::flush_out()
+{
+    if(m_out.empty()) { return true; }
+    size_t n = pptr() - pbase();
+    bool ok = write_all(m_fd, pbase(), n, m_error) == n;
+    setp(m_out.data(), m_out.data() + m_out.size());
+    return ok;
+}
+
+void FdStreamBuf::throw_error()
+{
+    throw std::system_error(m_error, std::generic_category(), "fd stream");
+}
+
+FdStreamBuf::int_type FdStreamBuf::underflow()
+{
+    if(gptr() < egptr()) { return traits_type::to_int_type(*gptr()); }
+    if(m_error) { throw_error(); }
+    if(m_in.empty()) { m_in.resize(m_buffer_size); }
+    long got = read_some(m_fd, m_in.data(), m_in.size());
+    if(got < 0)
+    {
+        m_error = errno;
+        throw_error();
+    }
+    if(got == 0) { return traits_type::eof(); }
+    setg(m_in.data(), m_in.data(), m_in.data() + got);
+    return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize FdStreamBuf::xsgetn(char * s, std::streamsize n)
+{
+    std::streamsize done = 0;
+    while(done < n)
+    {
+        std::streamsize buffered = egptr() - gptr();
+        if(buffered > 0)
+        {
+            std::streamsize len = std::min(buffered, n - done);
+            std::memcpy(s + done, gptr(), len);
+            gbump(int(len));
+            done += len;
+        }
+        else if(size_t(n - done) >= m_buffer_size)
+        {
+            // big read, skip the copy through m_in
+            if(m_error && done == 0) { throw_error(); }
+            long got = read_some(m_fd, s + done, n - done);
+            if(got < 0)
+            {
+                // hand over what arrived, the next read throws
+                m_error = errno;
+                if(done == 0) { throw_error(); }
+                break;
+            }
+            if(got == 0) { break; }
+            done += got;
+        }
+        else if(underflow() == traits_type::eof())
+        {
+            break;
+        }
+    }
+    return done;
+}
+
+FdStreamBuf::int_type FdStreamBuf::overflow(int_type c)
+{
+    if(m_out.empty())
+    {
+        m_out.resize(m_buffer_size);
+        setp(m_out.data(), m_out.data() + m_out.size());
+    }
+    else if(!flush_out())
+    {
+        return traits_type::eof();
+    }
+    if(!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize FdStreamBuf::xsputn(char const* s, std::streamsize n)
+{
+    if(m_out.empty())
+    {
+        m_out.resize(m_buffer_size);
+        setp(m_out.data(), m_out.data() + m_out.size());
+    }
+    std::streamsize room = epptr() - pptr();
+    if(n < room)
+    {
+        std::memcpy(pptr(), s, n);
+        pbump(int(n));
+        return n;
+    }
+    if(size_t(n) >= m_buffer_size)
+    {
+        // big write, skip the copy through m_out
+        if(!flush_out()) { return 0; }
+        return write_all(m_fd, s, n, m_error);
+    }
+    // top up the buffer so every syscall moves a full one
+    std::memcpy(pptr(), s, room);
+    pbump(int(room));
+    if(!flush_out()) { return 0; }
+    std::memcpy(pptr(), s + room, n - room);
+    pbump(int(n - room));
+    return n;
+}
+
+int FdStreamBuf::sync()
+{
+    return flush_out() ? 0 : -1;
+}
+
+} // namespace audioplus
@@ -0,0 +1,189 @@
+#include "audioplus/fft.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace audioplus {
+
+static constexpr double pi = 3.14159265358979323846;
+
+Fft::Fft(int size)
+:   m_size(size)
+{
+    if(size < 4 || (size & (size - 1)))
+        throw std::runtime_error("fft size must be a power of 2");
+
+    int half = size / 2;
+    // stage h (butterflies h apart) uses w^k = e^(-2 pi i k / 2h), k < h
+    m_twiddle_re.resize(half - 1);
+    m_twiddle_im.resize(half - 1);
+    for(int h=1 ; h<half ; h*=2)
+    {
+        for(int k=0 ; k<h ; k++)
+        {
+            std::complex<double> w = std::polar(1.0, -pi * k / h);
+            m_twiddle_re[h - 1 + k] = w.real();
+            m_twiddle_im[h - 1 + k] = w.imag();
+        }
+    }
+    m_post.resize(half);
+    for(int k=0 ; k<half ; k++)
+    {
+        m_post[k] = std::polar(1.0, -2.0 * pi * k / size);
+    }
+    m_bitrev.resize(half);
+    int bits = 0;
+    while((1 << bits) < half) { bits++; }
+    for(int i=0 ; i<half ; i++)
+    {
+        int r = 0;
+        for(int b=0 ; b<bits ; b++) { r |= ((i >> b) & 1) << (bits - 1 - b); }
+        m_bitrev[i] = r;
+    }
+    m_work_re.resize(half);
+    m_work_im.resize(half);
+}
+
+// one stage on a pair of runs h apart, which never overlap
+// h is a multiple of 4, written 4 wide so it vectorizes at -O2 as well
+static void butterflies(float * __restrict a_re, float * __restrict a_im,
+    float * __restrict b_re, float * __restrict b_im,
+    float const* __restrict w_re, float const* __restrict w_im, int h)
+{
+    for(int k=0 ; k<h ; k+=4)
+    {
+        for(int j=k ; j<k+4 ; j++)
+        {
+            float tr = b_re[j] * w_re[j] - b_im[j] * w_im[j];
+            float ti = b_re[j] * w_im[j] + b_im[j] * w_re[j];
+            b_re[j] = a_re[j] - tr;
+            b_im[j] = a_im[j] - ti;
+            a_re[j] += tr;
+            a_im[j] += ti;
+        }
+    }
+}
+
+// in place radix 2, forward direction
+static void complex_fft(float * re, float * im, int n, std::vector<int> const& bitrev,
+    std::vector<float> const& twiddle_re, std::vector<float> const& twiddle_im)
+{
+    for(int i=0 ; i<n ; i++)
+    {
+        int j = bitrev[i];
+        if(i < j)
+        {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+    if(n == 2)
+    {
+        float r = re[0], i = im[0];
+        re[0] = r + re[1];
+        im[0] = i + im[1];
+        re[1] = r - re[1];
+        im[1] = i - im[1];
+        return;
+    }
+    // the first two stages have twiddles 1 and -i, done in one pass
+    // so the generic stages start with runs of at least 4
+    for(int i=0 ; i<n ; i+=4)
+    {
+        float r0 = re[i] + re[i+1], i0 = im[i] + im[i+1];
+        float r1 = re[i] - re[i+1], i1 = im[i] - im[i+1];
+        float r2 = re[i+2] + re[i+3], i2 = im[i+2] + im[i+3];
+        float r3 = re[i+2] - re[i+3], i3 = im[i+2] - im[i+3];
+        re[i] = r0 + r2;
+        im[i] = i0 + i2;
+        re[i+2] = r0 - r2;
+        im[i+2] = i0 - i2;
+        // (r3 + i i3) * -i
+        re[i+1] = r1 + i3;
+        im[i+1] = i1 - r3;
+        re[i+3] = r1 - i3;
+        im[i+3] = i1 + r3;
+    }
+    for(int h=4 ; h<n ; h*=2)
+    {
+        float const* w_re = twiddle_re.data() + h - 1;
+        float const* w_im = twiddle_im.data() + h - 1;
+        for(int i=0 ; i<n ; i+=2*h)
+        {
+            butterflies(re + i, im + i, re + i + h, im + i + h, w_re, w_im, h);
+        }
+    }
+}
+
+void Fft::forward(float const* in, float * re, float * im)
+{
+    int half = m_size / 2;
+    float * z_re = m_work_re.data();
+    float * z_im = m_work_im.data();
+    for(int k=0 ; k<half ; k++)
+    {
+        z_re[k] = in[2*k];
+        z_im[k] = in[2*k+1];
+    }
+    complex_fft(z_re, z_im, half, m_bitrev, m_twiddle_re, m_twiddle_im);
+
+    // split the packed even / odd spectra back out
+    // bins 0 and half both come from z[0]
+    re[0] = z_re[0] + z_im[0];
+    im[0] = 0;
+    re[half] = z_re[0] - z_im[0];
+    im[half] = 0;
+    for(int k=1 ; k<half ; k++)
+    {
+        // a = z[k], b = conj(z[half-k])
+        float a_re = z_re[k], a_im = z_im[k];
+        float b_re = z_re[half - k], b_im = -z_im[half - k];
+        float even_re = 0.5f * (a_re + b_re), even_im = 0.5f * (a_im + b_im);
+        // odd = -i/2 (a - b)
+        float odd_re = 0.5f * (a_im - b_im), odd_im = -0.5f * (a_re - b_re);
+        float w_re = m_post[k].real(), w_im = m_post[k].imag();
+        re[k] = even_re + (w_re * odd_re - w_im * odd_im);
+        im[k] = even_im + (w_re * odd_im + w_im * odd_re);
+    }
+}
+
+void Fft::inverse(float const* re, float const* im, float * out)
+{
+    int half = m_size / 2;
+    float * z_re = m_work_re.data();
+    float * z_im = m_work_im.data();
+    for(int k=0 ; k<half ; k++)
+    {
+        float a_re = re[k], a_im = im[k];
+        float b_re = re[half - k], b_im = -im[half - k];
+        float even_re = 0.5f * (a_re + b_re), even_im = 0.5f * (a_im + b_im);
+        // odd = (a - b) / 2 * conj(w)
+        float d_re = 0.5f * (a_re - b_re), d_im = 0.5f * (a_im - b_im);
+        float w_re = m_post[k].real(), w_im = m_post[k].imag();
+        float odd_re = d_re * w_re + d_im * w_im;
+        float odd_im = d_im * w_re - d_re * w_im;
+        // conjugated so the forward kernel computes the inverse
+        z_re[k] = even_re - odd_im;
+        z_im[k] = -(even_im + odd_re);
+    }
+    complex_fft(z_re, z_im, half, m_bitrev, m_twiddle_re, m_twiddle_im);
+    float scale = 1.0f / half;
+    for(int k=0 ; k<half ; k++)
+    {
+        out[2*k] = z_re[k] * scale;
+        out[2*k+1] = -z_im[k] * scale;
+    }
+}
+
+void complex_mac(float * __restrict acc_re, float * __restrict acc_im,
+    float const* __restrict a_re, float const* __restrict a_im,
+    float const* __restrict b_re, float const* __restrict b_im, int n)
+{
+    for(int i=0 ; i<n ; i++)
+    {
+        acc_re[i] += a_re[i] * b_re[i] - a_im[i] * b_im[i];
+        acc_im[i] += a_re[i] * b_im[i] + a_im[i] * b_re[i];
+    }
+}
+
+} // namespace audioplus
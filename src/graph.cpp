@@ -0,0 +1,434 @@
+#include "audioplus/graph.h"
+#include "audioplus/thread.h"
+
+#include <atomic>
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace audioplus {
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// fixed capacity Chase-Lev deque
+// owner pushes and pops the bottom, thieves take from the top
+// every node is queued at most once per callback, so no growth needed
+struct alignas(64) WorkDeque
+{
+    std::atomic<int64_t> top {0};
+    std::atomic<int64_t> bottom {0};
+    std::vector<std::atomic<int>> buf;
+    int64_t mask = 0;
+
+    void resize(int capacity)
+    {
+        int size = 1;
+        while(size < capacity) { size *= 2; }
+        buf = std::vector<std::atomic<int>>(size);
+        mask = size - 1;
+    }
+
+    void push(int item)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        buf[b & mask].store(item, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release);
+    }
+
+    int pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if(t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return -1;
+        }
+        int item = buf[b & mask].load(std::memory_order_relaxed);
+        if(t == b)
+        {
+            // last item, race the thieves for it
+            if(!top.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                item = -1;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    int steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if(t >= b) { return -1; }
+        int item = buf[t & mask].load(std::memory_order_relaxed);
+        if(!top.compare_exchange_strong(t, t + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return -1;
+        }
+        return item;
+    }
+};
+
+
+struct Graph::Impl
+{
+    std::vector<GraphNode *> nodes;
+    // sources[node][input port], node = -1 for graph inputs
+    std::vector<std::vector<Port>> sources;
+    std::vector<Port> output_sources;
+
+    // compiled schedule
+    std::vector<int> order;
+    std::vector<std::vector<int>> succ;
+    std::vector<int> indegree;
+    std::vector<int> roots;
+    std::vector<float const*> in_ptrs; // per node, flattened
+    std::vector<float *> out_ptrs;
+    std::vector<int> in_offset;
+    std::vector<int> out_offset;
+    std::vector<float const*> graph_in; // per graph input channel
+    std::vector<float const*> graph_out; // per graph output channel
+    std::vector<float> arena;
+    int buffers = 0;
+
+    // execution state
+    std::unique_ptr<std::atomic<int>[]> pending;
+    std::atomic<int> remaining {0};
+    std::atomic<int> frames_now {0};
+    std::atomic<uint32_t> epoch {0};
+    std::atomic<bool> quit {false};
+    std::unique_ptr<WorkDeque[]> deques;
+    int n_deques = 1;
+    std::vector<std::thread> threads;
+
+    ~Impl() { stop_workers(); }
+
+    void stop_workers()
+    {
+        quit.store(true, std::memory_order_relaxed);
+        for(auto & t : threads) { t.join(); }
+        threads.clear();
+        quit.store(false, std::memory_order_relaxed);
+    }
+
+    void execute(int node, WorkDeque & self)
+    {
+        // ordered by the deque handoff, unlike the epoch a worker woke on
+        int frames = frames_now.load(std::memory_order_relaxed);
+        nodes[node]->process(
+            in_ptrs.data() + in_offset[node],
+            out_ptrs.data() + out_offset[node],
+            frames);
+        for(int s : succ[node])
+        {
+            if(pending[s].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                self.push(s);
+            }
+        }
+        remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    // pop own work first, then steal round robin until the graph is done
+    void run(int self)
+    {
+        while(remaining.load(std::memory_order_acquire) > 0)
+        {
+            int node = deques[self].pop();
+            for(int i=1 ; node < 0 && i<n_deques ; i++)
+            {
+                node = deques[(self + i) % n_deques].steal();
+            }
+            if(node < 0) { cpu_relax(); continue; }
+            execute(node, deques[self]);
+        }
+    }
+
+    void worker(int self, ThreadPolicy policy)
+    {
+        apply_thread_policy(policy);
+        uint32_t seen = epoch.load(std::memory_order_acquire);
+        int idle = 0;
+        while(!quit.load(std::memory_order_relaxed))
+        {
+            uint32_t now = epoch.load(std::memory_order_acquire);
+            if(now == seen)
+            {
+                // stay hot for the next callback, but don't starve the os
+                if(++idle < 4096) { cpu_relax(); }
+                else { std::this_thread::yield(); }
+                continue;
+            }
+            seen = now;
+            idle = 0;
+            run(self);
+        }
+    }
+
+    void process(int frames)
+    {
+        if(n_deques == 1)
+        {
+            for(int node : order)
+            {
+                nodes[node]->process(
+                    in_ptrs.data() + in_offset[node],
+                    out_ptrs.data() + out_offset[node],
+                    frames);
+            }
+            return;
+        }
+        for(size_t i=0 ; i<nodes.size() ; i++)
+        {
+            pending[i].store(indegree[i], std::memory_order_relaxed);
+        }
+        remaining.store(nodes.size(), std::memory_order_relaxed);
+        frames_now.store(frames, std::memory_order_relaxed);
+        for(int r : roots) { deques[0].push(r); }
+        epoch.fetch_add(1, std::memory_order_release);
+        run(0);
+    }
+};
+
+
+Graph::Graph()
+:   m_impl(new Impl())
+{
+}
+Graph::~Graph()
+{
+}
+
+int Graph::add(GraphNode * node)
+{
+    m_impl->nodes.push_back(node);
+    m_impl->sources.emplace_back(node->inputs, Port{external, -1});
+    return m_impl->nodes.size() - 1;
+}
+
+void Graph::connect(Port src, Port dst)
+{
+    Impl & g = *m_impl;
+    int n = g.nodes.size();
+
+    if(src.node < external || src.node >= n || src.port < 0
+        || (src.node == external && src.port >= input_channels)
+        || (src.node != external && src.port >= g.nodes[src.node]->outputs))
+        throw std::runtime_error("graph source port out of range");
+
+    if(dst.node < external || dst.node >= n || dst.port < 0
+        || (dst.node == external && dst.port >= output_channels)
+        || (dst.node != external && dst.port >= g.nodes[dst.node]->inputs))
+        throw std::runtime_error("graph destination port out of range");
+
+    if(dst.node == external)
+    {
+        g.output_sources.resize(output_channels, Port{external, -1});
+        g.output_sources[dst.port] = src;
+    }
+    else
+    {
+        g.sources[dst.node][dst.port] = src;
+    }
+}
+
+int Graph::buffer_count() const
+{
+    return m_impl->buffers;
+}
+
+void Graph::compile()
+{
+    Impl & g = *m_impl;
+    g.stop_workers();
+
+    int n = g.nodes.size();
+    g.output_sources.resize(output_channels, Port{external, -1});
+
+    // dependency edges and kahn topological order
+
+    g.succ.assign(n, {});
+    g.indegree.assign(n, 0);
+    for(int v=0 ; v<n ; v++)
+    {
+        for(Port src : g.sources[v])
+        {
+            if(src.node == external) { continue; }
+            auto & s = g.succ[src.node];
+            if(std::find(s.begin(), s.end(), v) != s.end()) { continue; }
+            s.push_back(v);
+            g.indegree[v]++;
+        }
+    }
+
+    g.order.clear();
+    g.roots.clear();
+    std::vector<int> deg = g.indegree;
+    for(int v=0 ; v<n ; v++)
+    {
+        if(deg[v] == 0) { g.order.push_back(v); g.roots.push_back(v); }
+    }
+    for(size_t i=0 ; i<g.order.size() ; i++)
+    {
+        for(int s : g.succ[g.order[i]])
+        {
+            if(--deg[s] == 0) { g.order.push_back(s); }
+        }
+    }
+    if((int)g.order.size() != n)
+        throw std::runtime_error("graph has a cycle");
+
+    // ancestors[v][u] = u always finishes before v starts
+
+    std::vector<std::vector<bool>> ancestors(n, std::vector<bool>(n, false));
+    for(int v : g.order)
+    {
+        for(int s : g.succ[v])
+        {
+            auto & a = ancestors[s];
+            a[v] = true;
+            for(int u=0 ; u<n ; u++) { a[u] = a[u] || ancestors[v][u]; }
+        }
+    }
+
+    // buffer plan
+    // slot 0 is silence, then graph inputs, then node outputs
+    // a slot is reused once every node touching its last value
+    // is an ancestor of the new writer, so parallel branches never alias
+
+    std::vector<std::vector<std::vector<int>>> readers(n);
+    for(int v=0 ; v<n ; v++) { readers[v].resize(g.nodes[v]->outputs); }
+    std::vector<std::vector<bool>> to_output(n);
+    for(int v=0 ; v<n ; v++) { to_output[v].resize(g.nodes[v]->outputs); }
+    for(int v=0 ; v<n ; v++)
+    {
+        for(Port src : g.sources[v])
+        {
+            if(src.node != external) { readers[src.node][src.port].push_back(v); }
+        }
+    }
+    for(Port src : g.output_sources)
+    {
+        if(src.node != external && src.port >= 0) { to_output[src.node][src.port] = true; }
+    }
+
+    struct Slot
+    {
+        std::vector<int> users;
+        bool pinned = false;
+    };
+    std::vector<Slot> slots(1 + input_channels);
+    for(auto & slot : slots) { slot.pinned = true; }
+
+    std::vector<std::vector<int>> out_slot(n);
+    for(int v : g.order)
+    {
+        for(int p=0 ; p<g.nodes[v]->outputs ; p++)
+        {
+            int pick = -1;
+            for(size_t s=0 ; s<slots.size() && pick<0 ; s++)
+            {
+                if(slots[s].pinned) { continue; }
+                bool free = true;
+                for(int u : slots[s].users) { free = free && ancestors[v][u]; }
+                if(free) { pick = s; }
+            }
+            if(pick < 0)
+            {
+                pick = slots.size();
+                slots.emplace_back();
+            }
+            slots[pick].users = readers[v][p];
+            slots[pick].users.push_back(v);
+            slots[pick].pinned = to_output[v][p];
+            out_slot[v].push_back(pick);
+        }
+    }
+
+    g.buffers = slots.size();
+    g.arena.assign(size_t(g.buffers) * max_frames, 0.0f);
+    auto slot_ptr = [&] (int s) { return g.arena.data() + size_t(s) * max_frames; };
+    auto source_ptr = [&] (Port src) -> float const* {
+        if(src.port < 0) { return slot_ptr(0); }
+        if(src.node == external) { return slot_ptr(1 + src.port); }
+        return slot_ptr(out_slot[src.node][src.port]);
+    };
+
+    g.in_ptrs.clear();
+    g.out_ptrs.clear();
+    g.in_offset.assign(n, 0);
+    g.out_offset.assign(n, 0);
+    for(int v=0 ; v<n ; v++)
+    {
+        g.in_offset[v] = g.in_ptrs.size();
+        for(Port src : g.sources[v]) { g.in_ptrs.push_back(source_ptr(src)); }
+        g.out_offset[v] = g.out_ptrs.size();
+        for(int s : out_slot[v]) { g.out_ptrs.push_back(slot_ptr(s)); }
+    }
+
+    g.graph_in.clear();
+    for(int c=0 ; c<input_channels ; c++) { g.graph_in.push_back(slot_ptr(1 + c)); }
+    g.graph_out.clear();
+    for(Port src : g.output_sources) { g.graph_out.push_back(source_ptr(src)); }
+
+    // workers
+
+    g.pending.reset(new std::atomic<int>[n]);
+    g.n_deques = workers + 1;
+    g.deques.reset(new WorkDeque[workers + 1]);
+    for(int i=0 ; i<=workers ; i++) { g.deques[i].resize(std::max(n, 1)); }
+
+    int cpus = std::max(1u, std::thread::hardware_concurrency());
+    for(int i=1 ; i<=workers ; i++)
+    {
+        ThreadPolicy policy = helper_thread_policy();
+        if(pin_workers) { policy.cpu = (first_cpu + i - 1) % cpus; }
+        g.threads.emplace_back(&Impl::worker, &g, i, policy);
+    }
+}
+
+int Graph::on_audio(float const* input, float * output, int frames)
+{
+    Impl & g = *m_impl;
+    for(int done=0 ; done<frames ; )
+    {
+        int n = std::min(frames - done, max_frames);
+
+        for(int c=0 ; c<input_channels ; c++)
+        {
+            float * dst = (float *)g.graph_in[c];
+            float const* src = input + size_t(done) * input_channels + c;
+            for(int i=0 ; i<n ; i++) { dst[i] = src[i * input_channels]; }
+        }
+
+        g.process(n);
+
+        for(int c=0 ; c<output_channels ; c++)
+        {
+            float const* src = g.graph_out[c];
+            float * dst = output + size_t(done) * output_channels + c;
+            for(int i=0 ; i<n ; i++) { dst[i * output_channels] = src[i]; }
+        }
+
+        done += n;
+    }
+    return 0;
+}
+
+} // namespace audioplus
@@ -0,0 +1,383 @@
+#include "audioplus/meter.h"
+#include "audioplus/triple_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace audioplus {
+
+static constexpr double pi = 3.14159265358979323846;
+
+// ITU-R BS.1770-4 annex 2, 48 tap interpolator split into 4 phases
+static constexpr int tp_taps = 12;
+static constexpr int tp_block = 256; // frames per true peak pass, on the stack
+static float const tp_coefs[4][tp_taps] = {
+    { 0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f,
+     -0.0594482421875f,  0.1373291015625f,  0.9721679687500f, -0.1022949218750f,
+      0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+    {-0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f,
+     -0.1665039062500f,  0.4650878906250f,  0.7797851562500f, -0.2003173828125f,
+      0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+    {-0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f,
+     -0.2003173828125f,  0.7797851562500f,  0.4650878906250f, -0.1665039062500f,
+      0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+    {-0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f,
+     -0.1022949218750f,  0.9721679687500f,  0.1373291015625f, -0.0594482421875f,
+      0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f },
+};
+
+struct Biquad
+{
+    double b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+};
+
+// K-weighting state for k_lanes channels, filtered side by side
+static constexpr int k_lanes = 4;
+struct KLanes
+{
+    double shelf1[k_lanes] {}, shelf2[k_lanes] {};
+    double highpass1[k_lanes] {}, highpass2[k_lanes] {};
+    double sum[k_lanes] {}; // K-weighted energy in the current 100 ms block
+};
+
+static constexpr int k_block = 64; // frames per K-weighting pass, on the stack
+
+// shelf then highpass on each lane, accumulating the output energy
+// x86-64 always has SSE2, two lanes per register; the compilers don't
+// vectorize the scalar version reliably once the state lives in registers
+static void k_weight(KLanes & z, Biquad const& s, Biquad const& h,
+    double const (*in)[k_lanes], int frames)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    constexpr int regs = k_lanes / 2;
+    __m128d shelf1[regs], shelf2[regs], highpass1[regs], highpass2[regs], sum[regs];
+    for(int r=0 ; r<regs ; r++)
+    {
+        shelf1[r] = _mm_loadu_pd(z.shelf1 + 2*r);
+        shelf2[r] = _mm_loadu_pd(z.shelf2 + 2*r);
+        highpass1[r] = _mm_loadu_pd(z.highpass1 + 2*r);
+        highpass2[r] = _mm_loadu_pd(z.highpass2 + 2*r);
+        sum[r] = _mm_loadu_pd(z.sum + 2*r);
+    }
+    __m128d sb0 = _mm_set1_pd(s.b0), sb1 = _mm_set1_pd(s.b1), sb2 = _mm_set1_pd(s.b2);
+    __m128d sa1 = _mm_set1_pd(s.a1), sa2 = _mm_set1_pd(s.a2);
+    __m128d hb0 = _mm_set1_pd(h.b0), hb1 = _mm_set1_pd(h.b1), hb2 = _mm_set1_pd(h.b2);
+    __m128d ha1 = _mm_set1_pd(h.a1), ha2 = _mm_set1_pd(h.a2);
+    for(int i=0 ; i<frames ; i++)
+    {
+        for(int r=0 ; r<regs ; r++)
+        {
+            __m128d v = _mm_loadu_pd(in[i] + 2*r);
+            __m128d y = _mm_add_pd(_mm_mul_pd(sb0, v), shelf1[r]);
+            shelf1[r] = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(sb1, v), _mm_mul_pd(sa1, y)), shelf2[r]);
+            shelf2[r] = _mm_sub_pd(_mm_mul_pd(sb2, v), _mm_mul_pd(sa2, y));
+            __m128d w = _mm_add_pd(_mm_mul_pd(hb0, y), highpass1[r]);
+            highpass1[r] = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(hb1, y), _mm_mul_pd(ha1, w)), highpass2[r]);
+            highpass2[r] = _mm_sub_pd(_mm_mul_pd(hb2, y), _mm_mul_pd(ha2, w));
+            sum[r] = _mm_add_pd(sum[r], _mm_mul_pd(w, w));
+        }
+    }
+    for(int r=0 ; r<regs ; r++)
+    {
+        _mm_storeu_pd(z.shelf1 + 2*r, shelf1[r]);
+        _mm_storeu_pd(z.shelf2 + 2*r, shelf2[r]);
+        _mm_storeu_pd(z.highpass1 + 2*r, highpass1[r]);
+        _mm_storeu_pd(z.highpass2 + 2*r, highpass2[r]);
+        _mm_storeu_pd(z.sum + 2*r, sum[r]);
+    }
+#else
+    for(int i=0 ; i<frames ; i++)
+    {
+        for(int j=0 ; j<k_lanes ; j++)
+        {
+            double v = in[i][j];
+            double y = s.b0 * v + z.shelf1[j];
+            z.shelf1[j] = s.b1 * v - s.a1 * y + z.shelf2[j];
+            z.shelf2[j] = s.b2 * v - s.a2 * y;
+            double w = h.b0 * y + z.highpass1[j];
+            z.highpass1[j] = h.b1 * y - h.a1 * w + z.highpass2[j];
+            z.highpass2[j] = h.b2 * y - h.a2 * w;
+            z.sum[j] += w * w;
+        }
+    }
+#endif
+}
+
+// BS.1770 K-weighting, generalized to any sample rate
+static void k_weighting(double sample_rate, Biquad & shelf, Biquad & highpass)
+{
+    double f0 = 1681.974450955533;
+    double gain_db = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = std::tan(pi * f0 / sample_rate);
+    double vh = std::pow(10.0, gain_db / 20.0);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    shelf.b0 = (vh + vb * k / q + k * k) / a0;
+    shelf.b1 = 2.0 * (k * k - vh) / a0;
+    shelf.b2 = (vh - vb * k / q + k * k) / a0;
+    shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+    shelf.a2 = (1.0 - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = std::tan(pi * f0 / sample_rate);
+    a0 = 1.0 + k / q + k * k;
+    highpass.b0 = 1.0;
+    highpass.b1 = -2.0;
+    highpass.b2 = 1.0;
+    highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+    highpass.a2 = (1.0 - k / q + k * k) / a0;
+}
+
+static double lufs(double mean_square)
+{
+    return mean_square > 0 ? -0.691 + 10.0 * std::log10(mean_square) : -1e9;
+}
+
+
+struct Meter::Impl
+{
+    struct Channel
+    {
+        float peak = 0;
+        double sum_sq = 0;
+        float true_peak = 0;
+        float hist[tp_taps - 1] {}; // last inputs, oldest first
+        double weight = 1;
+    };
+
+    int channels;
+    std::vector<Channel> state;
+    Biquad shelf, highpass;
+    std::vector<KLanes> k_state;
+    // per lane accumulators for the flat kernels, 4 frames wide
+    std::vector<float> lane_peak;
+    std::vector<float> lane_sq;
+
+    int interval_frames;
+    int interval_done = 0;
+    int block_frames; // 100 ms loudness block
+    int block_done = 0;
+    double blocks[30] {}; // ring of the last 3 s of loudness blocks
+    int block_count = 0;
+    uint64_t frame = 0;
+    float momentary = -1e9f;
+    float short_term = -1e9f;
+
+    TripleBuffer<MeterLevels> published;
+
+    Impl(int channels, double sample_rate, double interval)
+    :   channels(channels),
+        state(channels),
+        k_state((channels + k_lanes - 1) / k_lanes),
+        lane_peak(4 * channels),
+        lane_sq(4 * channels),
+        interval_frames(std::max(1, int(interval * sample_rate))),
+        block_frames(std::max(1, int(sample_rate / 10)))
+    {
+        if(channels <= 0) { throw std::runtime_error("meter needs channels"); }
+        k_weighting(sample_rate, shelf, highpass);
+        if(channels == 6)
+        {
+            // 5.1: LFE excluded, surrounds weighted +1.5 dB
+            state[3].weight = 0;
+            state[4].weight = 1.41;
+            state[5].weight = 1.41;
+        }
+        for(auto & s : published.m_buf) { s.channels.resize(channels); }
+    }
+
+    // peak and energy over a flat interleaved run
+    // lanes are contiguous, so the inner loop vectorizes for any channel count
+    void levels(float const* x, int frames)
+    {
+        int lanes = 4 * channels;
+        std::fill(lane_peak.begin(), lane_peak.end(), 0.0f);
+        std::fill(lane_sq.begin(), lane_sq.end(), 0.0f);
+        float * peak = lane_peak.data();
+        float * sq = lane_sq.data();
+        int n = frames * channels;
+        int i = 0;
+        for( ; i+lanes <= n ; i+=lanes)
+        {
+            for(int j=0 ; j<lanes ; j++)
+            {
+                float v = x[i + j];
+                peak[j] = std::max(peak[j], std::fabs(v));
+                sq[j] += v * v;
+            }
+        }
+        for(int j=0 ; i<n ; i++, j++)
+        {
+            peak[j] = std::max(peak[j], std::fabs(x[i]));
+            sq[j] += x[i] * x[i];
+        }
+        for(int j=0 ; j<lanes ; j++)
+        {
+            Channel & c = state[j % channels];
+            c.peak = std::max(c.peak, peak[j]);
+            c.sum_sq += sq[j];
+        }
+    }
+
+    // each run of a channel is copied out contiguous behind its history,
+    // then every phase is one multiply-add pass per tap over the run
+    void true_peak(Channel & c, float const* x, int frames)
+    {
+        float buf[tp_taps - 1 + tp_block];
+        float * in = buf + tp_taps - 1;
+        float acc[tp_block];
+        float peak[8];
+        std::copy(c.hist, c.hist + tp_taps - 1, buf);
+        std::fill(peak, peak + 8, c.true_peak);
+        for(int done=0 ; done<frames ; done+=tp_block)
+        {
+            int n = std::min(tp_block, frames - done);
+            // filter whole vectors, the padding outputs are never looked at
+            int padded = (n + 7) & ~7;
+            for(int i=0 ; i<n ; i++) { in[i] = x[(done + i) * channels]; }
+            std::fill(in + n, in + padded, 0.0f);
+            for(int p=0 ; p<4 ; p++)
+            {
+                std::fill(acc, acc + padded, 0.0f);
+                for(int k=0 ; k<tp_taps ; k++)
+                {
+                    float coef = tp_coefs[p][k];
+                    float const* h = in - k;
+                    for(int i=0 ; i<padded ; i++) { acc[i] += coef * h[i]; }
+                }
+                int i = 0;
+                for( ; i+8 <= n ; i+=8)
+                {
+                    for(int j=0 ; j<8 ; j++) { peak[j] = std::max(peak[j], std::fabs(acc[i + j])); }
+                }
+                for( ; i<n ; i++) { peak[0] = std::max(peak[0], std::fabs(acc[i])); }
+            }
+            std::copy(in + n - (tp_taps - 1), in + n, buf);
+        }
+        std::copy(buf, buf + tp_taps - 1, c.hist);
+        c.true_peak = *std::max_element(peak, peak + 8);
+    }
+
+    // the recurrence is serial in time, so the filters run across channels,
+    // k_lanes wide on a padded copy of the input with silence in spare lanes
+    void loudness(float const* x, int frames)
+    {
+        Biquad const s = shelf;
+        Biquad const h = highpass;
+        double in[k_block][k_lanes];
+        for(size_t g=0 ; g<k_state.size() ; g++)
+        {
+            int first = g * k_lanes;
+            int width = std::min(k_lanes, channels - first);
+            KLanes & z = k_state[g];
+            for(int done=0 ; done<frames ; done+=k_block)
+            {
+                int n = std::min(k_block, frames - done);
+                for(int i=0 ; i<n ; i++)
+                {
+                    float const* f = x + (done + i) * channels + first;
+                    for(int j=0 ; j<k_lanes ; j++) { in[i][j] = j < width ? f[j] : 0.0; }
+                }
+                k_weight(z, s, h, in, n);
+            }
+        }
+    }
+
+    void end_block()
+    {
+        double energy = 0;
+        for(int i=0 ; i<channels ; i++)
+        {
+            double & sum = k_state[i / k_lanes].sum[i % k_lanes];
+            energy += state[i].weight * sum / block_frames;
+            sum = 0;
+        }
+        blocks[block_count % 30] = energy;
+        block_count++;
+
+        int n = std::min(block_count, 4);
+        double sum = 0;
+        for(int i=1 ; i<=n ; i++) { sum += blocks[(block_count - i) % 30]; }
+        momentary = lufs(sum / n);
+
+        n = std::min(block_count, 30);
+        sum = 0;
+        for(int i=1 ; i<=n ; i++) { sum += blocks[(block_count - i) % 30]; }
+        short_term = lufs(sum / n);
+    }
+
+    void publish()
+    {
+        MeterLevels & out = published.write_slot();
+        for(int i=0 ; i<channels ; i++)
+        {
+            Channel & c = state[i];
+            out.channels[i].peak = c.peak;
+            out.channels[i].rms = std::sqrt(c.sum_sq / interval_done);
+            out.channels[i].true_peak = std::max(c.true_peak, c.peak);
+            c.peak = 0;
+            c.sum_sq = 0;
+            c.true_peak = 0;
+        }
+        out.momentary_lufs = momentary;
+        out.short_term_lufs = short_term;
+        out.frame = frame;
+        published.write_commit();
+    }
+};
+
+
+Meter::Meter(int channels, double sample_rate, double interval)
+:   m_impl(new Impl(channels, sample_rate, interval))
+{
+}
+Meter::~Meter()
+{
+}
+
+void Meter::process(float const* samples, int frames)
+{
+    Impl & m = *m_impl;
+    while(frames > 0)
+    {
+        // split at the next publish or loudness block boundary
+        int n = std::min(frames, std::min(
+            m.interval_frames - m.interval_done,
+            m.block_frames - m.block_done));
+
+        m.levels(samples, n);
+        for(int c=0 ; c<m.channels ; c++) { m.true_peak(m.state[c], samples + c, n); }
+        m.loudness(samples, n);
+
+        m.frame += n;
+        m.interval_done += n;
+        m.block_done += n;
+        if(m.block_done == m.block_frames)
+        {
+            m.end_block();
+            m.block_done = 0;
+        }
+        if(m.interval_done == m.interval_frames)
+        {
+            m.publish();
+            m.interval_done = 0;
+        }
+
+        samples += n * m.channels;
+        frames -= n;
+    }
+}
+
+MeterLevels const& Meter::read()
+{
+    return m_impl->published.read_slot();
+}
+
+} // namespace audioplus
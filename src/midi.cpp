@@ -80,6 +80,7 @@ MidiInputStream MidiSession::open(MidiInputStream::Config & cfg)
         (PmTimeProcPtr)cfg.clock_time_fn,
         cfg.clock_time_ctx
     ) );
+    out.config = cfg;
 
     return out;
 }
@@ -88,10 +89,14 @@ MidiInputStream MidiSession::open(MidiInputStream::Config & cfg)
 MidiInputStream::MidiInputStream(MidiInputStream && o)
 {
     std::swap(backend, o.backend);
+    std::swap(config, o.config);
+    lost = o.lost.exchange(false);
 }
 MidiInputStream & MidiInputStream::operator=(MidiInputStream && o)
 {
     std::swap(backend, o.backend);
+    std::swap(config, o.config);
+    lost = o.lost.exchange(lost);
     return *this;
 }
 
@@ -118,6 +123,7 @@ int MidiInputStream::read(MidiMsg * buf, int buf_size)
 
     PmEvent * pbuf = (PmEvent *)buf;
     int count = Pm_Read(backend, pbuf, buf_size);
+    if(count == pmHostError || count == pmDeviceRemoved) { lost = true; }
     throw_pm_error(count);
 
     // repack struct as a portability precaution.
@@ -134,6 +140,26 @@ int MidiInputStream::read(MidiMsg * buf, int buf_size)
     return count;
 }
 
+bool MidiInputStream::device_lost() const
+{
+    return lost;
+}
+void MidiInputStream::reopen(MidiDevice device)
+{
+    // the old device may be gone, errors closing it don't matter
+    close(std::nothrow_t{});
+    lost = false;
+    config.device.index = device.index < 0 ? Pm_GetDefaultInputDeviceID() : device.index;
+    throw_pm_error( Pm_OpenInput(
+        &backend,
+        config.device.index,
+        nullptr, // SysDepInfo
+        config.buffer_size,
+        (PmTimeProcPtr)config.clock_time_fn,
+        config.clock_time_ctx
+    ) );
+}
+
 
 
 
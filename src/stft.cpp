@@ -0,0 +1,252 @@
+#include "audioplus/stft.h"
+#include "audioplus/fft.h"
+#include "audioplus/thread.h"
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace audioplus {
+
+static constexpr double pi = 3.14159265358979323846;
+
+static std::vector<float> make_window(Stft::Window type, int size)
+{
+    std::vector<float> w(size, 1.0f);
+    for(int i=0 ; i<size ; i++)
+    {
+        double x = 2.0 * pi * i / size; // periodic, sums flat at common hops
+        switch(type)
+        {
+            case Stft::Rect: break;
+            case Stft::Hann: w[i] = 0.5 - 0.5 * std::cos(x); break;
+            case Stft::Hamming: w[i] = 0.54 - 0.46 * std::cos(x); break;
+            case Stft::Blackman: w[i] = 0.42 - 0.5 * std::cos(x) + 0.08 * std::cos(2 * x); break;
+        }
+    }
+    return w;
+}
+
+static double hz_to_mel(double hz) { return 2595.0 * std::log10(1.0 + hz / 700.0); }
+static double mel_to_hz(double mel) { return 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0); }
+
+// triangular bands evenly spaced in mel, 0 Hz to nyquist
+struct MelBank
+{
+    std::vector<int> start; // first bin per band
+    std::vector<std::vector<float>> weights;
+
+    MelBank(int bands, int size, double sample_rate)
+    {
+        int bins = size / 2 + 1;
+        double top = hz_to_mel(sample_rate / 2);
+        std::vector<double> edge(bands + 2);
+        for(int i=0 ; i<bands+2 ; i++)
+        {
+            edge[i] = mel_to_hz(top * i / (bands + 1)) * size / sample_rate;
+        }
+        for(int b=0 ; b<bands ; b++)
+        {
+            int lo = std::max(0, int(std::ceil(edge[b])));
+            int hi = std::min(bins - 1, int(std::floor(edge[b + 2])));
+            // edges of narrow low bands can coincide, a flat slope
+            // then stands in for the zero-width one
+            double rise = edge[b + 1] - edge[b];
+            double fall = edge[b + 2] - edge[b + 1];
+            start.push_back(lo);
+            weights.emplace_back();
+            for(int k=lo ; k<=hi ; k++)
+            {
+                double w = k < edge[b + 1] ?
+                    (rise > 0 ? (k - edge[b]) / rise : 1.0) :
+                    (fall > 0 ? (edge[b + 2] - k) / fall : 1.0);
+                weights.back().push_back(std::max(0.0, w));
+            }
+        }
+    }
+
+    void apply(float const* power, float * mel) const
+    {
+        for(size_t b=0 ; b<weights.size() ; b++)
+        {
+            float sum = 0;
+            float const* p = power + start[b];
+            for(size_t k=0 ; k<weights[b].size() ; k++) { sum += weights[b][k] * p[k]; }
+            mel[b] = sum;
+        }
+    }
+};
+
+// per thread scratch for one window at a time
+struct StftKernel
+{
+    Fft fft;
+    std::vector<float> buf, re, im;
+
+    StftKernel(int size)
+    :   fft(size), buf(size), re(size / 2 + 1), im(size / 2 + 1)
+    {
+    }
+
+    void run(float const* x, std::vector<float> const& window,
+        MelBank const* mel, SpectrumFrame & out)
+    {
+        int size = fft.size();
+        for(int i=0 ; i<size ; i++) { buf[i] = x[i] * window[i]; }
+        fft.forward(buf.data(), re.data(), im.data());
+        float * power = out.power.data();
+        for(size_t k=0 ; k<re.size() ; k++) { power[k] = re[k] * re[k] + im[k] * im[k]; }
+        if(mel) { mel->apply(power, out.mel.data()); }
+    }
+};
+
+
+struct Stft::Impl
+{
+    Config cfg;
+    std::vector<float> window;
+    std::unique_ptr<MelBank> mel;
+
+    Queue<float, 1 << 16> input;
+    std::atomic<int> dropped {0};
+    std::atomic<bool> quit {false};
+    std::thread worker;
+
+    Impl(Config const& cfg)
+    :   cfg(cfg),
+        window(make_window(cfg.window, cfg.size))
+    {
+        // checked here, the worker thread builds its own Fft and
+        // an exception there would terminate
+        if(cfg.size < 4 || (cfg.size & (cfg.size - 1)))
+            throw std::runtime_error("stft size must be a power of 2, at least 4");
+        if(cfg.hop <= 0 || cfg.hop > cfg.size)
+            throw std::runtime_error("stft hop must be in 1..size");
+        if(cfg.mel_bands > cfg.size / 2 + 1)
+            throw std::runtime_error("stft mel_bands must be at most size/2+1");
+        if(cfg.mel_bands > 0)
+            mel.reset(new MelBank(cfg.mel_bands, cfg.size, cfg.sample_rate));
+    }
+
+    void prepare(SpectrumFrame & f) const
+    {
+        f.power.resize(cfg.size / 2 + 1);
+        f.mel.resize(std::max(0, cfg.mel_bands));
+    }
+
+    void loop(Queue<SpectrumFrame, 64> & frames)
+    {
+        StftKernel kernel(cfg.size);
+        std::vector<float> hist(cfg.size, 0.0f); // window being filled
+        int fill = 0;
+        uint64_t position = 0; // samples consumed
+        auto idle = std::chrono::microseconds(
+            std::max<int64_t>(100, int64_t(2.5e5 * cfg.hop / cfg.sample_rate)));
+
+        while(!quit.load(std::memory_order_relaxed))
+        {
+            int ready = input.read_ready();
+            if(ready == 0)
+            {
+                std::this_thread::sleep_for(idle);
+                continue;
+            }
+            for(int i=0 ; i<ready ; i++)
+            {
+                hist[fill++] = input.read_slot(i);
+                position++;
+                if(fill < cfg.size) { continue; }
+
+                if(frames.write_ready() == 0) { dropped++; }
+                else
+                {
+                    SpectrumFrame & out = frames.write_slot();
+                    kernel.run(hist.data(), window, mel.get(), out);
+                    out.frame = position - cfg.size;
+                    frames.write_commit();
+                }
+
+                // keep the overlap for the next window
+                std::copy(hist.begin() + cfg.hop, hist.end(), hist.begin());
+                fill = cfg.size - cfg.hop;
+            }
+            input.read_commit(ready);
+        }
+    }
+};
+
+
+Stft::Stft(Config const& cfg)
+:   m_impl(new Impl(cfg))
+{
+    for(auto & f : frames.m_buf) { m_impl->prepare(f); }
+    // the first window is due once `size` samples are in
+    ThreadPolicy policy = helper_thread_policy();
+    m_impl->worker = std::thread([this, policy] {
+        apply_thread_policy(policy);
+        m_impl->loop(frames);
+    });
+}
+
+Stft::~Stft()
+{
+    m_impl->quit.store(true, std::memory_order_relaxed);
+    m_impl->worker.join();
+}
+
+int Stft::push(float const* samples, int count)
+{
+    Impl & m = *m_impl;
+    int channels = m.cfg.channels;
+    int n = std::min<int>(count, m.input.write_ready());
+    for(int i=0 ; i<n ; i++)
+    {
+        float sum = 0;
+        for(int c=0 ; c<channels ; c++) { sum += samples[i * channels + c]; }
+        m.input.write_slot(i) = sum / channels;
+    }
+    m.input.write_commit(n);
+    return n;
+}
+
+int Stft::dropped_frames() const
+{
+    return m_impl->dropped.load(std::memory_order_relaxed);
+}
+
+std::vector<SpectrumFrame> Stft::analyze(float const* mono, size_t count, int threads) const
+{
+    Impl const& m = *m_impl;
+    int size = m.cfg.size;
+    int hop = m.cfg.hop;
+    size_t n = count >= size_t(size) ? 1 + (count - size) / hop : 0;
+
+    std::vector<SpectrumFrame> out(n);
+    for(auto & f : out) { m.prepare(f); }
+
+    if(threads <= 0) { threads = std::max(1u, std::thread::hardware_concurrency()); }
+    threads = std::max<size_t>(1, std::min<size_t>(threads, n));
+
+    auto work = [&] (size_t begin, size_t end) {
+        StftKernel kernel(size);
+        for(size_t i=begin ; i<end ; i++)
+        {
+            out[i].frame = i * hop;
+            kernel.run(mono + i * hop, m.window, m.mel.get(), out[i]);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for(int t=1 ; t<threads ; t++)
+    {
+        pool.emplace_back(work, n * t / threads, n * (t + 1) / threads);
+    }
+    work(0, n / threads);
+    for(auto & t : pool) { t.join(); }
+    return out;
+}
+
+} // namespace audioplus
@@ -0,0 +1,83 @@
+#include "audioplus/thread.h"
+
+#include <cerrno>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <alloca.h>
+#endif
+
+namespace audioplus {
+
+ThreadPolicy & helper_thread_policy()
+{
+    static ThreadPolicy policy;
+    return policy;
+}
+
+#ifdef __linux__
+__attribute__((noinline))
+void prefault_stack(size_t bytes)
+{
+    volatile char * stack = (volatile char *)alloca(bytes);
+    for(size_t i=0 ; i<bytes ; i+=4096) { stack[i] = 0; }
+}
+#else
+void prefault_stack(size_t) {}
+#endif
+
+int apply_thread_policy(ThreadPolicy const& policy)
+{
+    int err = 0;
+    if(policy.prefault_stack) { prefault_stack(policy.prefault_stack); }
+#ifdef __linux__
+    if(policy.cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(policy.cpu, &set);
+        int e = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if(e) { err = e; }
+    }
+    if(policy.priority > 0)
+    {
+        sched_param param {};
+        param.sched_priority = policy.priority;
+        int e = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if(e) { err = e; }
+    }
+#else
+    if(policy.cpu >= 0 || policy.priority > 0) { err = ENOSYS; }
+#endif
+    return err;
+}
+
+int lock_memory()
+{
+#ifdef __linux__
+    return mlockall(MCL_CURRENT | MCL_FUTURE) ? errno : 0;
+#else
+    return ENOSYS;
+#endif
+}
+
+ThreadStats current_thread_stats()
+{
+    ThreadStats stats;
+#ifdef __linux__
+    rusage usage;
+    if(getrusage(RUSAGE_THREAD, &usage) == 0)
+    {
+        stats.minor_faults = usage.ru_minflt;
+        stats.major_faults = usage.ru_majflt;
+        stats.voluntary_switches = usage.ru_nvcsw;
+        stats.involuntary_switches = usage.ru_nivcsw;
+    }
+#endif
+    return stats;
+}
+
+} // namespace audioplus
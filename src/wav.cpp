@@ -3,6 +3,23 @@
 #define DR_WAV_IMPLEMENTATION
 #include "dr_wav.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// x86-64 always has SSE2, the SSSE3 kernels are picked at runtime
+// so they run without -mssse3
+#if defined(__x86_64__) || defined(_M_X64)
+#define AUDIOPLUS_X86
+#include <tmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AUDIOPLUS_SSSE3
+#else
+#define AUDIOPLUS_SSSE3 __attribute__((target("ssse3")))
+#endif
+#endif
+
 namespace audioplus {
 
 static size_t read_callback(void * ctx, void * buf, size_t count)
@@ -19,6 +36,13 @@ static uint32_t iseek_callback(void * ctx, int offset, drwav_seek_origin drway)
         (drway == drwav_seek_origin_start) ?
         std::ios_base::beg : std::ios_base::cur;
     stream->seekg(offset, way);
+    if(stream->fail() && way == std::ios_base::cur && offset >= 0)
+    {
+        // pipes can't seek, skipping a chunk forward works by reading
+        stream->clear();
+        stream->ignore(offset);
+        return stream->gcount() == offset ? 1 : 0;
+    }
     return stream->fail() ? 0 : 1;
 }
 
@@ -40,12 +64,204 @@ static uint32_t oseek_callback(void * ctx, int offset, drwav_seek_origin drway)
 }
 
 
+// 24 bit pcm kernels
+// int32 values are full scale (sample << 8), matching dr_wav's s32 reads
+// SSSE3 moves 4 samples per shuffle, the scalar loops cover the rest
+// and any cpu without it
+
+static inline int32_t load24(uint8_t const* src)
+{
+    return int32_t(uint32_t(src[0]) << 8 | uint32_t(src[1]) << 16 | uint32_t(src[2]) << 24);
+}
+
+static inline void store24(uint8_t * dst, int32_t v)
+{
+    dst[0] = v >> 8;
+    dst[1] = v >> 16;
+    dst[2] = v >> 24;
+}
+
+// largest float that still maps into 24 bits, exact in float
+static constexpr float max24 = 8388607.0f / 8388608.0f;
+
+static inline int32_t float_to_s32(float x)
+{
+    x = std::min(std::max(x, -1.0f), max24);
+    return int32_t(std::lrint(x * 8388608.0f)) * 256;
+}
+
+#ifdef AUDIOPLUS_X86
+
+#ifdef __SSSE3__
+static constexpr bool cpu_ssse3 = true;
+#else
+static bool detect_ssse3()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return info[2] & (1 << 9);
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+static bool const cpu_ssse3 = detect_ssse3();
+#endif
+
+AUDIOPLUS_SSSE3 static inline void store12(uint8_t * dst, __m128i v)
+{
+    _mm_storel_epi64((__m128i *)dst, v);
+    int32_t tail = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+    std::memcpy(dst + 8, &tail, 4);
+}
+
+// each returns how many samples it converted
+
+// 16 byte loads, stop while a full load still fits in the input
+AUDIOPLUS_SSSE3 static int unpack24_ssse3(uint8_t const* src, int32_t * dst, int n)
+{
+    __m128i const mask = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    int i = 0;
+    for( ; i+6 <= n ; i+=4)
+    {
+        __m128i v = _mm_loadu_si128((__m128i const*)(src + 3*i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_shuffle_epi8(v, mask));
+    }
+    return i;
+}
+
+AUDIOPLUS_SSSE3 static int unpack24_ssse3(uint8_t const* src, float * dst, int n)
+{
+    __m128i const mask = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    __m128 const scale = _mm_set1_ps(1.0f / 2147483648.0f);
+    int i = 0;
+    for( ; i+6 <= n ; i+=4)
+    {
+        __m128i v = _mm_loadu_si128((__m128i const*)(src + 3*i));
+        v = _mm_shuffle_epi8(v, mask);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+    return i;
+}
+
+AUDIOPLUS_SSSE3 static int pack24_ssse3(int32_t const* src, uint8_t * dst, int n)
+{
+    __m128i const mask = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1);
+    int i = 0;
+    for( ; i+4 <= n ; i+=4)
+    {
+        __m128i v = _mm_loadu_si128((__m128i const*)(src + i));
+        store12(dst + 3*i, _mm_shuffle_epi8(v, mask));
+    }
+    return i;
+}
+
+AUDIOPLUS_SSSE3 static int pack24_ssse3(float const* src, uint8_t * dst, int n)
+{
+    __m128i const mask = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1);
+    __m128 const lo = _mm_set1_ps(-1.0f);
+    __m128 const hi = _mm_set1_ps(max24);
+    __m128 const scale = _mm_set1_ps(8388608.0f);
+    int i = 0;
+    for( ; i+4 <= n ; i+=4)
+    {
+        __m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), lo), hi);
+        __m128i v = _mm_slli_epi32(_mm_cvtps_epi32(_mm_mul_ps(x, scale)), 8);
+        store12(dst + 3*i, _mm_shuffle_epi8(v, mask));
+    }
+    return i;
+}
+
+#endif // AUDIOPLUS_X86
+
+static void unpack24(uint8_t const* src, int32_t * dst, int n)
+{
+    int i = 0;
+#ifdef AUDIOPLUS_X86
+    if(cpu_ssse3) { i = unpack24_ssse3(src, dst, n); }
+#endif
+    for( ; i<n ; i++) { dst[i] = load24(src + 3*i); }
+}
+
+static void unpack24(uint8_t const* src, float * dst, int n)
+{
+    constexpr float scale = 1.0f / 2147483648.0f;
+    int i = 0;
+#ifdef AUDIOPLUS_X86
+    if(cpu_ssse3) { i = unpack24_ssse3(src, dst, n); }
+#endif
+    for( ; i<n ; i++) { dst[i] = load24(src + 3*i) * scale; }
+}
+
+static void pack24(int32_t const* src, uint8_t * dst, int n)
+{
+    int i = 0;
+#ifdef AUDIOPLUS_X86
+    if(cpu_ssse3) { i = pack24_ssse3(src, dst, n); }
+#endif
+    for( ; i<n ; i++) { store24(dst + 3*i, src[i]); }
+}
+
+static void pack24(float const* src, uint8_t * dst, int n)
+{
+    int i = 0;
+#ifdef AUDIOPLUS_X86
+    if(cpu_ssse3) { i = pack24_ssse3(src, dst, n); }
+#endif
+    for( ; i<n ; i++) { store24(dst + 3*i, float_to_s32(src[i])); }
+}
+
+// dr_wav frees without a size, but memory_resource needs one,
+// so every block carries its size in a max-aligned prefix
+static constexpr size_t alloc_prefix = alignof(std::max_align_t);
+
+static void * malloc_callback(size_t size, void * ctx)
+{
+    auto * memory = (std::pmr::memory_resource *)ctx;
+    char * block = (char *)memory->allocate(
+        size + alloc_prefix, alignof(std::max_align_t));
+    *(size_t *)block = size;
+    return block + alloc_prefix;
+}
+
+static void free_callback(void * ptr, void * ctx)
+{
+    if(!ptr) { return; }
+    auto * memory = (std::pmr::memory_resource *)ctx;
+    char * block = (char *)ptr - alloc_prefix;
+    memory->deallocate(block,
+        *(size_t *)block + alloc_prefix, alignof(std::max_align_t));
+}
+
+static void * realloc_callback(void * ptr, size_t size, void * ctx)
+{
+    void * out = malloc_callback(size, ctx);
+    if(ptr)
+    {
+        size_t old_size = *(size_t *)((char *)ptr - alloc_prefix);
+        std::memcpy(out, ptr, std::min(old_size, size));
+        free_callback(ptr, ctx);
+    }
+    return out;
+}
+
+
 struct WavStreamBase::Impl
 {
     drwav m_wav;
     WavHeader m_header;
+    std::pmr::memory_resource * m_memory;
+    drwav_allocation_callbacks m_alloc;
+
+    Impl(std::pmr::memory_resource * memory)
+    :   m_memory(memory),
+        m_alloc{memory, malloc_callback, realloc_callback, free_callback}
+    {
+    }
 
-    Impl(void * ctx) // read mode
+    Impl(std::pmr::memory_resource * memory, void * ctx) // read mode
+    :   Impl(memory)
     {
         if(drwav_init_ex(
             &m_wav, 
@@ -55,12 +271,20 @@ struct WavStreamBase::Impl
             ctx,
             nullptr, // onChunk ctx
             DRWAV_SEQUENTIAL, 
-            nullptr // allocator
+            &m_alloc
         )) 
         { 
             m_header.sample_rate = m_wav.sampleRate;
             m_header.channels = m_wav.channels;
             m_header.frames = m_wav.totalPCMFrameCount;
+            // a data chunk claiming all of RIFF's 4 GB is a stream that
+            // didn't know its length, like our own unknown_frames header
+            uint64_t align = std::max(1, m_wav.channels * m_wav.bitsPerSample / 8);
+            if(m_wav.container == drwav_container_riff
+                && m_wav.dataChunkDataSize + 36 + align > 0xFFFFFFFFull)
+            {
+                m_header.frames = WavHeader::unknown_frames;
+            }
             int format = (m_wav.translatedFormatTag << 16) + m_wav.bitsPerSample;
             constexpr int type_int = DR_WAVE_FORMAT_PCM << 16;
             constexpr int type_float = DR_WAVE_FORMAT_IEEE_FLOAT << 16;
@@ -69,13 +293,15 @@ struct WavStreamBase::Impl
                 case type_float+64: m_header.dtype = WavHeader::Float64; break;
                 case type_float+32: m_header.dtype = WavHeader::Float32; break;
                 case type_int+32: m_header.dtype = WavHeader::Int32; break;
+                case type_int+24: m_header.dtype = WavHeader::Int24; break;
                 case type_int+16: m_header.dtype = WavHeader::Int16; break;
                 default: m_header.dtype = WavHeader::OTHER;
             }
         }
     }
 
-    Impl(void * ctx, WavHeader header) // write mode
+    Impl(std::pmr::memory_resource * memory, void * ctx, WavHeader header) // write mode
+    :   Impl(memory)
     {
         m_header = header;
 
@@ -99,6 +325,10 @@ struct WavStreamBase::Impl
                 format.format = DR_WAVE_FORMAT_PCM;
                 format.bitsPerSample = 32;
                 break;
+            case WavHeader::Int24:
+                format.format = DR_WAVE_FORMAT_PCM;
+                format.bitsPerSample = 24;
+                break;
             case WavHeader::Int16:
                 format.format = DR_WAVE_FORMAT_PCM;
                 format.bitsPerSample = 16;
@@ -107,14 +337,34 @@ struct WavStreamBase::Impl
                 return;
         }
 
-        if(drwav_init_write(
+        bool ok = false;
+        if(header.frames == WavHeader::unknown_frames)
+        {
+            // nothing gets patched at finish(), so declare the largest
+            // whole number of frames a RIFF data chunk can hold
+            uint64_t align = std::max(1u, header.channels * format.bitsPerSample / 8);
+            uint64_t frames = (0xFFFFFFFFull - 36) / align;
+            ok = drwav_init_write_sequential(
+                &m_wav,
+                &format,
+                frames * header.channels,
+                write_callback,
+                ctx,
+                &m_alloc
+            );
+        }
+        else
+        {
+            ok = drwav_init_write(
                 &m_wav, 
                 &format,
                 write_callback,
                 oseek_callback,
                 ctx,
-                nullptr // allocator
-        ))
+                &m_alloc
+            );
+        }
+        if(ok)
         {
             m_header = header;
         }
@@ -123,18 +373,46 @@ struct WavStreamBase::Impl
     ~Impl() { drwav_uninit(&m_wav); }
 };
 
-WavStreamBase::WavStreamBase()
+void WavStreamBase::ImplDelete::operator()(Impl * impl) const
+{
+    std::pmr::memory_resource * memory = impl->m_memory;
+    impl->~Impl();
+    memory->deallocate(impl, sizeof(Impl), alignof(Impl));
+}
+
+WavStreamBase::WavStreamBase(std::pmr::memory_resource * memory)
+:   m_memory(memory)
 {   
 }
 WavStreamBase::~WavStreamBase()
 {
 }
 
+template<class... Args>
+static void make_impl(WavStreamBase * w, Args... args)
+{
+    std::pmr::memory_resource * memory = w->m_memory ?
+        w->m_memory : std::pmr::new_delete_resource();
+    void * place = memory->allocate(
+        sizeof(WavStreamBase::Impl), alignof(WavStreamBase::Impl));
+    try
+    {
+        w->m_impl.reset(new (place) WavStreamBase::Impl(memory, args...));
+    }
+    catch(...)
+    {
+        // e.g. a bounded resource ran out inside dr_wav's init
+        memory->deallocate(place,
+            sizeof(WavStreamBase::Impl), alignof(WavStreamBase::Impl));
+        throw;
+    }
+}
+
 static bool prep_read(WavStreamBase * w, std::istream & stream)
 {
     if(!w->m_impl)
     {
-        w->m_impl.reset(new WavStreamBase::Impl((void *)&stream));
+        make_impl(w, (void *)&stream);
     }
     if(!w->m_impl->valid())
     { 
@@ -151,22 +429,72 @@ int WavStreamBase::read(std::istream & stream, WavHeader * header)
     return 0;
 }
 
+// chunk size for 24 bit conversions, kept on the stack so io stays allocation free
+static constexpr int packed_chunk = 1536;
+
+template<class T, class ReadFn>
+static int read_samples(WavStreamBase * w, T * samples, int count, ReadFn read_fn)
+{
+    drwav & wav = w->m_impl->m_wav;
+    int channels = wav.channels;
+    if(w->m_impl->m_header.dtype != WavHeader::Int24 || channels > packed_chunk)
+    {
+        return read_fn(&wav, count / channels, samples) * channels;
+    }
+    uint8_t raw[3 * packed_chunk];
+    int chunk = packed_chunk / channels;
+    int done = 0;
+    while(done + channels <= count)
+    {
+        int frames = std::min(chunk, (count - done) / channels);
+        int got = drwav_read_pcm_frames(&wav, frames, raw);
+        unpack24(raw, samples + done, got * channels);
+        done += got * channels;
+        if(got < frames) { break; }
+    }
+    return done;
+}
+
+// a short count is EOF unless the stream underneath failed, e.g. a read()
+// error on a pipe (FdStreamBuf sets badbit for those)
+static int io_result(WavStreamBase * w, std::ios const& stream, int count)
+{
+    if(!stream.bad()) { return count; }
+    w->error_message = "wav stream io error";
+    return -1;
+}
+
 int WavStreamBase::read(std::istream & stream, float * samples, int count)
 {
     if(!prep_read(this, stream)) { return -1; }
-    return drwav_read_pcm_frames_f32(&m_impl->m_wav, count, samples);
+    return io_result(this, stream, read_samples(this, samples, count, drwav_read_pcm_frames_f32));
 }
 
 int WavStreamBase::read(std::istream & stream, int32_t * samples, int count)
 {
     if(!prep_read(this, stream)) { return -1; }
-    return drwav_read_pcm_frames_s32(&m_impl->m_wav, count, samples);
+    return io_result(this, stream, read_samples(this, samples, count, drwav_read_pcm_frames_s32));
 }
 
 int WavStreamBase::read(std::istream & stream, int16_t * samples, int count)
 {
     if(!prep_read(this, stream)) { return -1; }
-    return drwav_read_pcm_frames_s16(&m_impl->m_wav, count, samples);
+    drwav & wav = m_impl->m_wav;
+    return io_result(this, stream,
+        drwav_read_pcm_frames_s16(&wav, count / wav.channels, samples) * wav.channels);
+}
+
+int WavStreamBase::read(std::istream & stream, Packed24 * samples, int count)
+{
+    if(!prep_read(this, stream)) { return -1; }
+    if(m_impl->m_header.dtype != WavHeader::Int24)
+    {
+        error_message = "wav data is not 24 bit";
+        return -1;
+    }
+    drwav & wav = m_impl->m_wav;
+    return io_result(this, stream,
+        drwav_read_pcm_frames(&wav, count / wav.channels, samples) * wav.channels);
 }
 
 int WavStreamBase::write(std::ostream & stream, WavHeader const* header)
@@ -176,7 +504,7 @@ int WavStreamBase::write(std::ostream & stream, WavHeader const* header)
         error_message = "wav header already set";
         return -1;
     }
-    m_impl.reset(new Impl((void *)&stream, *header));
+    make_impl(this, (void *)&stream, *header);
     if(!m_impl->valid())
     {
         error_message = "wav header write failed";
@@ -200,28 +528,62 @@ static bool check_write(WavStreamBase * w, WavHeader::DType dtype)
     return true;
 }
 
+template<class T>
+static int write_samples(WavStreamBase * w, T const* samples, int count)
+{
+    drwav & wav = w->m_impl->m_wav;
+    int channels = wav.channels;
+    if(w->m_impl->m_header.dtype != WavHeader::Int24)
+    {
+        return drwav_write_pcm_frames(&wav, count / channels, samples) * channels;
+    }
+    if(channels > packed_chunk)
+    {
+        w->error_message = "too many channels for 24 bit conversion";
+        return -1;
+    }
+    uint8_t raw[3 * packed_chunk];
+    int chunk = packed_chunk / channels;
+    int done = 0;
+    while(done + channels <= count)
+    {
+        int frames = std::min(chunk, (count - done) / channels);
+        pack24(samples + done, raw, frames * channels);
+        int wrote = drwav_write_pcm_frames(&wav, frames, raw);
+        done += wrote * channels;
+        if(wrote < frames) { break; }
+    }
+    return done;
+}
+
 int WavStreamBase::write(std::ostream & stream, float const* samples, int count)
 {
-    if(!check_write(this, WavHeader::Float32)) { return -1; }
-    int frames = drwav_write_pcm_frames(&m_impl->m_wav,
-        count / m_impl->m_wav.channels, samples);
-    return frames * m_impl->m_wav.channels;
+    if(!check_write(this, WavHeader::Int24)
+        && !check_write(this, WavHeader::Float32)) { return -1; }
+    return io_result(this, stream, write_samples(this, samples, count));
 }
 
 int WavStreamBase::write(std::ostream & stream, int32_t const* samples, int count)
 {
-    if(!check_write(this, WavHeader::Int32)) { return -1; }
-    int frames = drwav_write_pcm_frames(&m_impl->m_wav,
-        count / m_impl->m_wav.channels, samples);
-    return frames * m_impl->m_wav.channels;
+    if(!check_write(this, WavHeader::Int24)
+        && !check_write(this, WavHeader::Int32)) { return -1; }
+    return io_result(this, stream, write_samples(this, samples, count));
 }
 
 int WavStreamBase::write(std::ostream & stream, int16_t const* samples, int count)
 {
     if(!check_write(this, WavHeader::Int16)) { return -1; }
-    int frames = drwav_write_pcm_frames(&m_impl->m_wav,
-        count / m_impl->m_wav.channels, samples);
-    return frames * m_impl->m_wav.channels;
+    drwav & wav = m_impl->m_wav;
+    return io_result(this, stream,
+        drwav_write_pcm_frames(&wav, count / wav.channels, samples) * wav.channels);
+}
+
+int WavStreamBase::write(std::ostream & stream, Packed24 const* samples, int count)
+{
+    if(!check_write(this, WavHeader::Int24)) { return -1; }
+    drwav & wav = m_impl->m_wav;
+    return io_result(this, stream,
+        drwav_write_pcm_frames(&wav, count / wav.channels, samples) * wav.channels);
 }
 
 void WavStreamBase::finish()
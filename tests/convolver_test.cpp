@@ -0,0 +1,94 @@
+// Convolver against a direct convolution, with the tail thread running
+// whole blocks come out undelayed, irregular frame counts come out
+// latency() frames late and otherwise identical
+
+#include "audioplus/convolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+#define CHECK(cond) do { if(!(cond)) { \
+    std::printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); failures++; } } while(0)
+
+using namespace audioplus;
+
+static constexpr int channels = 2;
+static constexpr int block = 64;
+static constexpr int len = 3000; // long enough for a tail, tail_block 256
+static constexpr int frames = 64 * 200;
+
+static unsigned g_seed = 7;
+static float noise()
+{
+    g_seed = g_seed * 1103515245 + 12345;
+    return int((g_seed >> 8) % 2001 - 1000) / 1000.0f;
+}
+
+// max |y[n] - (ir * x)[n - delay]| relative to the largest output
+static double error(std::vector<std::vector<float>> const& ir,
+    std::vector<float> const& x, std::vector<float> const& y, int delay)
+{
+    double err = 0;
+    double peak = 0;
+    for(int n=0 ; n<frames ; n++)
+    {
+        for(int c=0 ; c<channels ; c++)
+        {
+            double s = 0;
+            for(int k=0 ; k<len && k<=n-delay ; k++)
+            {
+                s += ir[c][k] * x[size_t(n - delay - k) * channels + c];
+            }
+            err = std::max(err, std::fabs(s - y[size_t(n) * channels + c]));
+            peak = std::max(peak, std::fabs(s));
+        }
+    }
+    return err / peak;
+}
+
+// process in the given frame counts, in place, paced so the tail thread
+// keeps up as it would behind an audio callback
+static std::vector<float> run(std::vector<std::vector<float>> const& ir,
+    std::vector<float> const& x, std::vector<int> const& sizes, int * latency)
+{
+    Convolver conv(ir, block, 256);
+    CHECK(conv.tail_block() == 256);
+    std::vector<float> y = x;
+    int done = 0;
+    for(size_t i=0 ; done<frames ; i++)
+    {
+        int n = std::min(sizes[i % sizes.size()], frames - done);
+        conv.process(y.data() + size_t(done) * channels, y.data() + size_t(done) * channels, n);
+        done += n;
+        std::this_thread::sleep_for(std::chrono::microseconds(3 * n));
+    }
+    CHECK(conv.late_tail_blocks() == 0);
+    *latency = conv.latency();
+    return y;
+}
+
+int main()
+{
+    std::vector<std::vector<float>> ir(channels, std::vector<float>(len));
+    for(auto & h : ir)
+        for(int k=0 ; k<len ; k++) { h[k] = noise() * std::exp(-k / 1000.0f); }
+    std::vector<float> x(size_t(frames) * channels);
+    for(float & v : x) { v = noise(); }
+
+    int latency = -1;
+    std::vector<float> y = run(ir, x, {block, 3 * block, 2 * block}, &latency);
+    CHECK(latency == 0);
+    CHECK(error(ir, x, y, 0) < 1e-4);
+
+    y = run(ir, x, {37, 100, 1, 256, 63, 129}, &latency);
+    CHECK(latency == block - 1);
+    CHECK(error(ir, x, y, latency) < 1e-4);
+
+    std::printf("%s\n", failures ? "failed" : "ok");
+    return failures != 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+// hooks into the stub portaudio / portmidi backends in pa_stub.cpp and
+// pm_stub.cpp: unplugging devices, shaping and tapping host buffers
+
+// the running audio stream stops calling back and reports itself finished,
+// as portaudio does when the host drops the device
+void pa_stub_unplug();
+
+// streams opened after this call back with sizes[i % sizes.size()] frames
+// in turn, instead of their chunk size; empty = chunk size again
+void pa_stub_host_chunks(std::vector<int> sizes);
+
+// streams opened after this run `fill` on the input buffer before each
+// callback and `drain` on the output after it, on the callback thread
+using PaStubTap = std::function<void(void * buffer, int frames)>;
+void pa_stub_taps(PaStubTap fill, PaStubTap drain);
+
+// Pa_IsFormatSupported calls so far
+int pa_stub_format_probes();
+
+// reads on the open midi streams fail with pmDeviceRemoved
+void pm_stub_unplug();
@@ -0,0 +1,268 @@
+// portaudio stand-in: two devices on a fake alsa host, each stream is a
+// thread calling back at the real rate of the chunks it delivers
+
+#include "portaudio.h"
+#include "device_stub.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct StubStream
+{
+    PaStreamCallback * callback = nullptr;
+    void * ctx = nullptr;
+    PaStreamFinishedCallback * finished = nullptr;
+    unsigned long frames = 0;
+    std::vector<int> chunks; // host sizes to cycle through, empty = frames
+    PaStubTap fill, drain;
+    PaStreamInfo info {};
+    // per channel, channels are contiguous so interleaved uses one pointer
+    std::vector<char> in_data;
+    std::vector<char> out_data;
+    std::vector<void *> in_channels;
+    std::vector<void *> out_channels;
+    bool in_planar = false;
+    bool out_planar = false;
+
+    std::thread thread;
+    std::atomic<bool> active {false};
+    std::atomic<bool> quit {false};
+    std::atomic<bool> unplugged {false};
+};
+
+std::mutex g_mutex;
+StubStream * g_running = nullptr; // the stream pa_stub_unplug() hits
+std::vector<int> g_chunks;
+PaStubTap g_fill, g_drain;
+std::atomic<int> g_probes {0};
+
+PaDeviceInfo g_devices[2];
+PaHostApiInfo g_host;
+
+double now()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+int sample_size(PaSampleFormat format)
+{
+    format &= ~paNonInterleaved;
+    if(format == paFloat32 || format == paInt32) { return 4; }
+    if(format == paInt24) { return 3; }
+    if(format == paInt16) { return 2; }
+    if(format == paInt8 || format == paUInt8) { return 1; }
+    return paSampleFormatNotSupported;
+}
+
+void alloc_side(PaStreamParameters const* params, unsigned long frames,
+    std::vector<char> & data, std::vector<void *> & channels, bool & planar)
+{
+    if(!params) { return; }
+    size_t channel_bytes = frames * sample_size(params->sampleFormat);
+    data.assign(channel_bytes * params->channelCount, 0);
+    planar = params->sampleFormat & paNonInterleaved;
+    for(int c=0 ; c<params->channelCount ; c++)
+    {
+        channels.push_back(data.data() + c * channel_bytes);
+    }
+}
+
+void run(StubStream * s)
+{
+    auto next = std::chrono::steady_clock::now();
+    for(size_t call=0 ; !s->quit && !s->unplugged ; call++)
+    {
+        unsigned long frames = s->chunks.empty() ? s->frames :
+            s->chunks[call % s->chunks.size()];
+        PaStreamCallbackTimeInfo time;
+        time.currentTime = now();
+        time.inputBufferAdcTime = time.currentTime - s->info.inputLatency;
+        time.outputBufferDacTime = time.currentTime + s->info.outputLatency;
+        void const* in = s->in_data.empty() ? nullptr :
+            s->in_planar ? (void *)s->in_channels.data() : s->in_data.data();
+        void * out = s->out_data.empty() ? nullptr :
+            s->out_planar ? (void *)s->out_channels.data() : s->out_data.data();
+        if(s->fill && in) { s->fill((void *)in, frames); }
+        int result = s->callback(in, out, frames, &time, 0, s->ctx);
+        if(s->drain && out) { s->drain(out, frames); }
+        if(result != paContinue) { break; }
+        auto period = std::chrono::duration<double>(frames / s->info.sampleRate);
+        next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+        std::this_thread::sleep_until(next);
+    }
+    s->active = false;
+    if(s->finished) { s->finished(s->ctx); }
+}
+
+} // namespace
+
+void pa_stub_unplug()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if(g_running) { g_running->unplugged = true; }
+}
+
+void pa_stub_host_chunks(std::vector<int> sizes)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_chunks = std::move(sizes);
+}
+
+void pa_stub_taps(PaStubTap fill, PaStubTap drain)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_fill = std::move(fill);
+    g_drain = std::move(drain);
+}
+
+int pa_stub_format_probes()
+{
+    return g_probes;
+}
+
+PaError Pa_Initialize(void)
+{
+    for(int i=0 ; i<2 ; i++)
+    {
+        PaDeviceInfo & d = g_devices[i];
+        d.structVersion = 2;
+        d.name = i == 0 ? "stub 0" : "stub 1";
+        d.hostApi = 0;
+        d.maxInputChannels = 2;
+        d.maxOutputChannels = 2;
+        d.defaultLowInputLatency = 0.005;
+        d.defaultLowOutputLatency = 0.005;
+        d.defaultHighInputLatency = 0.05;
+        d.defaultHighOutputLatency = 0.05;
+        d.defaultSampleRate = 48000;
+    }
+    g_host.structVersion = 1;
+    g_host.type = paALSA;
+    g_host.name = "stub";
+    g_host.deviceCount = 2;
+    g_host.defaultInputDevice = 0;
+    g_host.defaultOutputDevice = 0;
+    return paNoError;
+}
+PaError Pa_Terminate(void) { return paNoError; }
+const char * Pa_GetErrorText(PaError) { return "stub error"; }
+
+PaDeviceIndex Pa_GetDeviceCount(void) { return 2; }
+PaDeviceIndex Pa_GetDefaultInputDevice(void) { return g_host.defaultInputDevice; }
+PaDeviceIndex Pa_GetDefaultOutputDevice(void) { return g_host.defaultOutputDevice; }
+const PaDeviceInfo * Pa_GetDeviceInfo(PaDeviceIndex device)
+{
+    return device >= 0 && device < 2 ? &g_devices[device] : nullptr;
+}
+const PaHostApiInfo * Pa_GetHostApiInfo(PaHostApiIndex api)
+{
+    return api == 0 ? &g_host : nullptr;
+}
+
+PaError Pa_IsFormatSupported(const PaStreamParameters * in,
+    const PaStreamParameters * out, double)
+{
+    g_probes++;
+    if(in && sample_size(in->sampleFormat) < 0) { return paSampleFormatNotSupported; }
+    if(out && sample_size(out->sampleFormat) < 0) { return paSampleFormatNotSupported; }
+    return paFormatIsSupported;
+}
+PaError Pa_GetSampleSize(PaSampleFormat format) { return sample_size(format); }
+
+PaError Pa_OpenStream(PaStream ** stream, const PaStreamParameters * in,
+    const PaStreamParameters * out, double sample_rate, unsigned long frames,
+    PaStreamFlags, PaStreamCallback * callback, void * ctx)
+{
+    StubStream * s = new StubStream;
+    s->callback = callback;
+    s->ctx = ctx;
+    s->frames = frames ? frames : 256;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        s->chunks = g_chunks;
+        s->fill = g_fill;
+        s->drain = g_drain;
+    }
+    unsigned long most = s->frames;
+    for(int n : s->chunks) { most = std::max(most, (unsigned long)n); }
+    s->info.structVersion = 1;
+    s->info.inputLatency = in ? in->suggestedLatency : 0;
+    s->info.outputLatency = out ? out->suggestedLatency : 0;
+    s->info.sampleRate = sample_rate;
+    alloc_side(in, most, s->in_data, s->in_channels, s->in_planar);
+    alloc_side(out, most, s->out_data, s->out_channels, s->out_planar);
+    *stream = s;
+    return paNoError;
+}
+PaError Pa_SetStreamFinishedCallback(PaStream * stream, PaStreamFinishedCallback * finished)
+{
+    ((StubStream *)stream)->finished = finished;
+    return paNoError;
+}
+PaError Pa_StartStream(PaStream * stream)
+{
+    StubStream * s = (StubStream *)stream;
+    if(s->active) { return paStreamIsNotStopped; }
+    if(s->thread.joinable()) { s->thread.join(); }
+    s->quit = false;
+    s->active = true;
+    if(s->callback) { s->thread = std::thread(run, s); }
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_running = s;
+    return paNoError;
+}
+PaError Pa_AbortStream(PaStream * stream)
+{
+    StubStream * s = (StubStream *)stream;
+    s->quit = true;
+    if(s->thread.joinable()) { s->thread.join(); }
+    else if(s->active)
+    {
+        // blocking stream, no thread to report the end
+        s->active = false;
+        if(s->finished) { s->finished(s->ctx); }
+    }
+    return paNoError;
+}
+PaError Pa_StopStream(PaStream * stream)
+{
+    return Pa_AbortStream(stream);
+}
+PaError Pa_CloseStream(PaStream * stream)
+{
+    StubStream * s = (StubStream *)stream;
+    Pa_AbortStream(s);
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if(g_running == s) { g_running = nullptr; }
+    }
+    delete s;
+    return paNoError;
+}
+PaError Pa_IsStreamActive(PaStream * stream)
+{
+    return ((StubStream *)stream)->active;
+}
+const PaStreamInfo * Pa_GetStreamInfo(PaStream * stream)
+{
+    return &((StubStream *)stream)->info;
+}
+PaTime Pa_GetStreamTime(PaStream *) { return now(); }
+
+// blocking io moves silence, always ready
+PaError Pa_ReadStream(PaStream *, void *, unsigned long) { return paNoError; }
+PaError Pa_WriteStream(PaStream *, const void *, unsigned long) { return paNoError; }
+signed long Pa_GetStreamReadAvailable(PaStream * stream) { return ((StubStream *)stream)->frames; }
+signed long Pa_GetStreamWriteAvailable(PaStream * stream) { return ((StubStream *)stream)->frames; }
+
+void Pa_Sleep(long msec)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(msec));
+}
@@ -0,0 +1,75 @@
+// portmidi stand-in: two input devices, every read returns one note on
+
+#include "portmidi.h"
+#include "device_stub.h"
+
+#include <atomic>
+
+namespace {
+
+struct StubStream
+{
+    int generation; // streams opened before the last unplug are gone
+    int32_t sent = 0;
+};
+
+std::atomic<int> g_generation {0}; // bumped by each unplug
+PmDeviceInfo g_devices[2];
+
+} // namespace
+
+void pm_stub_unplug()
+{
+    g_generation++;
+}
+
+PmError Pm_Initialize(void)
+{
+    for(int i=0 ; i<2 ; i++)
+    {
+        PmDeviceInfo & d = g_devices[i];
+        d.structVersion = 1;
+        d.interf = "stub";
+        d.name = (char *)(i == 0 ? "stub 0" : "stub 1");
+        d.input = 1;
+        d.output = 0;
+        d.opened = 0;
+        d.is_virtual = 0;
+    }
+    return pmNoError;
+}
+PmError Pm_Terminate(void) { return pmNoError; }
+const char * Pm_GetErrorText(PmError err)
+{
+    return err == pmDeviceRemoved ? "device removed" : "stub error";
+}
+
+int Pm_CountDevices(void) { return 2; }
+PmDeviceID Pm_GetDefaultInputDeviceID(void) { return 0; }
+PmDeviceID Pm_GetDefaultOutputDeviceID(void) { return pmNoDevice; }
+const PmDeviceInfo * Pm_GetDeviceInfo(PmDeviceID id)
+{
+    return id >= 0 && id < 2 ? &g_devices[id] : nullptr;
+}
+
+PmError Pm_OpenInput(PortMidiStream ** stream, PmDeviceID device, void *,
+    int32_t, PmTimeProcPtr, void *)
+{
+    if(device < 0 || device >= 2) { return pmInvalidDeviceId; }
+    *stream = new StubStream {g_generation};
+    return pmNoError;
+}
+PmError Pm_Close(PortMidiStream * stream)
+{
+    delete (StubStream *)stream;
+    return pmNoError;
+}
+int Pm_Read(PortMidiStream * stream, PmEvent * buffer, int32_t length)
+{
+    StubStream * s = (StubStream *)stream;
+    if(s->generation != g_generation) { return pmDeviceRemoved; }
+    if(length < 1) { return 0; }
+    buffer[0].message = Pm_Message(0x90, 60, 100);
+    buffer[0].timestamp = s->sent++;
+    return 1;
+}
@@ -0,0 +1,84 @@
+// Rcu with a reader holding pointers across many publishes: nothing is
+// deleted while the reader may still use it, and everything is deleted
+// by the time the Rcu is
+
+#include "audioplus/rcu.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+static int failures = 0;
+#define CHECK(cond) do { if(!(cond)) { \
+    std::printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); failures++; } } while(0)
+
+using namespace audioplus;
+
+static constexpr int objects = 20000;
+static std::atomic<bool> g_deleted[objects + 1];
+static std::atomic<int> g_created {0};
+static std::atomic<int> g_destroyed {0};
+
+struct Obj
+{
+    int id;
+    Obj(int id) : id(id) { g_created++; }
+    ~Obj()
+    {
+        g_deleted[id] = true;
+        g_destroyed++;
+    }
+};
+
+int main()
+{
+    {
+        // reclaim often, so it races the reader
+        Rcu<Obj> rcu(std::make_unique<Obj>(0), std::chrono::milliseconds(1));
+        std::atomic<bool> done {false};
+        int early = 0;
+        int reads = 0;
+
+        std::thread reader([&] {
+            while(!done)
+            {
+                Obj * obj = rcu.read();
+                int id = obj->id;
+                // hold it, like a callback working on it
+                for(int spin=0 ; spin<(reads % 64) * 50 ; spin++)
+                {
+                    early += g_deleted[id].load();
+                }
+                if(reads % 256 == 0) { std::this_thread::sleep_for(std::chrono::milliseconds(2)); }
+                early += g_deleted[id].load();
+                early += obj->id != id;
+                reads++;
+            }
+        });
+
+        for(int i=1 ; i<=objects ; i++)
+        {
+            rcu.publish(std::make_unique<Obj>(i));
+            if(i % 100 == 0) { std::this_thread::sleep_for(std::chrono::microseconds(200)); }
+        }
+        // let the reader move past the last publish, then collect behind it
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        done = true;
+        reader.join();
+        rcu.collect();
+
+        CHECK(early == 0);
+        CHECK(reads > 0);
+        // only what the reader might still hold is left
+        CHECK(g_destroyed == objects);
+        CHECK(!g_deleted[objects]);
+        std::printf("%d reads\n", reads);
+    }
+    CHECK(g_created == objects + 1);
+    CHECK(g_destroyed == objects + 1);
+
+    std::printf("%s\n", failures ? "failed" : "ok");
+    return failures != 0;
+}
@@ -0,0 +1,99 @@
+// Config::block_frames behind irregular host chunks: on_audio only ever
+// sees whole blocks, and input comes back out delayed by exactly
+// block_latency_frames(); audio.cpp is built without NDEBUG here, so a
+// FrameRing overflow aborts the test
+// runs against the stub backend in pa_stub.cpp
+
+#include "audioplus/audio.h"
+#include "device_stub.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+#define CHECK(cond) do { if(!(cond)) { \
+    std::printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); failures++; } } while(0)
+
+using namespace audioplus;
+
+static constexpr int block = 64;
+
+struct Passthrough
+{
+    std::atomic<int> calls {0};
+    std::atomic<int> wrong_size {0};
+
+    int on_audio(float const* input, float * output, int frames, AudioStream::Status const&)
+    {
+        if(frames != block) { wrong_size++; }
+        for(int i=0 ; i<frames ; i++) { output[i] = input[i]; }
+        calls++;
+        return 0;
+    }
+};
+
+int main()
+{
+    // host frame t carries t + 1, so silence (0) is told apart from data
+    int64_t next_in = 0;
+    std::vector<float> recorded;
+    recorded.reserve(1 << 20);
+    pa_stub_host_chunks({100, 37, 256});
+    pa_stub_taps(
+        [&](void * buffer, int frames) {
+            for(int i=0 ; i<frames ; i++) { ((float *)buffer)[i] = float(++next_in); }
+        },
+        [&](void * buffer, int frames) {
+            recorded.insert(recorded.end(), (float *)buffer, (float *)buffer + frames);
+        });
+
+    AudioSession session;
+    Passthrough pass;
+    AudioStream::Config cfg;
+    cfg.on_audio(&pass);
+    cfg.input_channels = 1;
+    cfg.output_channels = 1;
+    cfg.sample_rate = 48000;
+    cfg.chunk_frames = 100;
+    cfg.block_frames = block;
+    AudioStream stream = session.open(cfg);
+    int initial = cfg.block_latency_frames;
+    stream.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    stream.stop();
+    int latency = stream.block_latency_frames();
+    pa_stub_host_chunks({});
+    pa_stub_taps(nullptr, nullptr);
+
+    CHECK(pass.calls > 100);
+    CHECK(pass.wrong_size == 0);
+    CHECK(latency >= initial && latency < 2 * block);
+
+    // the delay only ever grows, up to the reported latency, and has
+    // settled there well before the end
+    int64_t n = recorded.size();
+    int64_t delay = 0;
+    int grew_late = 0;
+    int wrong = 0;
+    for(int64_t t=0 ; t<n ; t++)
+    {
+        float v = recorded[t];
+        // silence is padding while the delay grows
+        if(v == 0) { grew_late += t > n / 2; continue; }
+        int64_t d = t + 1 - int64_t(v);
+        wrong += d < delay || d > latency;
+        grew_late += d > delay && t > n / 2;
+        delay = d;
+    }
+    CHECK(n > 10000);
+    CHECK(wrong == 0);
+    CHECK(grew_late == 0);
+    CHECK(delay == latency);
+    std::printf("block %d, host 100/37/256, latency %d (%d at open)\n", block, latency, initial);
+
+    std::printf("%s\n", failures ? "failed" : "ok");
+    return failures != 0;
+}
@@ -0,0 +1,200 @@
+// AudioStream / MidiInputStream recover from an unplugged device: loss is
+// seen from another thread, reopen() gets data flowing again, and the time
+// from reopen() to the first callback / message is printed
+// runs against the stub backends in pa_stub.cpp and pm_stub.cpp
+
+#include "audioplus/audio.h"
+#include "audioplus/midi.h"
+#include "device_stub.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+#define CHECK(cond) do { if(!(cond)) { \
+    std::printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); failures++; } } while(0)
+
+using namespace audioplus;
+using Clock = std::chrono::steady_clock;
+
+static double ms_since(Clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+// poll until cond() or timeout, return whether it happened
+template<class Cond>
+static bool wait_for(Cond cond, double timeout_ms = 2000)
+{
+    Clock::time_point t0 = Clock::now();
+    while(!cond())
+    {
+        if(ms_since(t0) > timeout_ms) { return false; }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return true;
+}
+
+struct Counter
+{
+    std::atomic<int> calls {0};
+
+    int on_audio(float const*, float * output, int frames, AudioStream::Status const&)
+    {
+        for(int i=0 ; i<frames * 2 ; i++) { output[i] = 0; }
+        calls++;
+        return 0;
+    }
+};
+
+static void audio_reopen()
+{
+    AudioSession session;
+    Counter counter;
+    AudioStream::Config cfg;
+    cfg.on_audio(&counter);
+    cfg.output_channels = 2;
+    cfg.sample_rate = 48000;
+    cfg.chunk_frames = 64;
+    AudioStream stream = session.open(cfg);
+    stream.start();
+    CHECK(wait_for([&] { return counter.calls > 10; }));
+    CHECK(!stream.device_lost());
+
+    pa_stub_unplug();
+    CHECK(wait_for([&] { return stream.device_lost(); }));
+
+    Clock::time_point t0 = Clock::now();
+    int before = counter.calls;
+    int probes = pa_stub_format_probes();
+    stream.reopen(AudioDevice{-1}, AudioDevice{1});
+    CHECK(pa_stub_format_probes() == probes); // dtype kept from open()
+    CHECK(wait_for([&] { return counter.calls > before; }));
+    double ms = ms_since(t0);
+    std::printf("audio reopen to first callback: %.3f ms\n", ms);
+    // the stub device calls back as soon as it starts, so this is all ours
+    CHECK(ms < 100);
+    CHECK(!stream.device_lost());
+    CHECK(stream.config().output_device.index == 1);
+    stream.stop();
+}
+
+struct Passthrough
+{
+    int on_audio(float const* input, float * output, int frames, AudioStream::Status const&)
+    {
+        for(int i=0 ; i<frames ; i++) { output[i] = input[i]; }
+        return 0;
+    }
+};
+
+// block_frames queues from the dead device are dropped, and the new one
+// runs at the latency block_latency_frames() reports from the start
+static void reblock_reopen()
+{
+    // host frame t carries t + 1, across both devices
+    int64_t next_in = 0;
+    std::vector<float> recorded;
+    recorded.reserve(1 << 20);
+    pa_stub_host_chunks({100, 37, 256});
+    pa_stub_taps(
+        [&](void * buffer, int frames) {
+            for(int i=0 ; i<frames ; i++) { ((float *)buffer)[i] = float(++next_in); }
+        },
+        [&](void * buffer, int frames) {
+            recorded.insert(recorded.end(), (float *)buffer, (float *)buffer + frames);
+        });
+
+    AudioSession session;
+    Passthrough pass;
+    AudioStream::Config cfg;
+    cfg.on_audio(&pass);
+    cfg.input_channels = 1;
+    cfg.output_channels = 1;
+    cfg.sample_rate = 48000;
+    cfg.chunk_frames = 100;
+    cfg.block_frames = 64;
+    AudioStream stream = session.open(cfg);
+    stream.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    pa_stub_unplug();
+    CHECK(wait_for([&] { return stream.device_lost(); }));
+
+    // the old device's thread is done, frame `mark` was its last
+    int64_t mark = next_in;
+    int64_t r0 = recorded.size();
+    stream.reopen();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    stream.stop();
+    pa_stub_host_chunks({});
+    pa_stub_taps(nullptr, nullptr);
+
+    int latency = stream.block_latency_frames();
+    int stale = 0;
+    int wrong = 0;
+    for(int64_t t=r0 ; t<int64_t(recorded.size()) ; t++)
+    {
+        float v = recorded[t];
+        if(v == 0) { wrong += t - r0 >= latency; continue; }
+        stale += v <= mark;
+        wrong += t + 1 - int64_t(v) != latency;
+    }
+    CHECK(int64_t(recorded.size()) > r0 + 1000);
+    CHECK(stale == 0);
+    CHECK(wrong == 0);
+}
+
+static void midi_reopen()
+{
+    MidiSession session;
+    MidiInputStream::Config cfg;
+    MidiInputStream stream = session.open(cfg);
+
+    // a reader thread until the device goes away, the main thread only
+    // watches device_lost()
+    std::atomic<int> received {0};
+    std::thread reader([&] {
+        MidiMsg buf[16];
+        try
+        {
+            for(;;)
+            {
+                received += stream.read(buf, 16);
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+        catch(std::runtime_error const&) {}
+    });
+    CHECK(wait_for([&] { return received > 10; }));
+    CHECK(!stream.device_lost());
+
+    pm_stub_unplug();
+    CHECK(wait_for([&] { return stream.device_lost(); }));
+    reader.join();
+
+    Clock::time_point t0 = Clock::now();
+    stream.reopen(MidiDevice{1});
+    MidiMsg msg;
+    int got = 0;
+    while(got == 0 && ms_since(t0) < 2000) { got = stream.read(&msg, 1); }
+    double ms = ms_since(t0);
+    std::printf("midi reopen to first message: %.3f ms\n", ms);
+    CHECK(got == 1 && msg.data[0] == 0x90 && msg.data[1] == 60);
+    CHECK(ms < 100);
+    CHECK(!stream.device_lost());
+    CHECK(stream.config.device.index == 1);
+}
+
+int main()
+{
+    audio_reopen();
+    reblock_reopen();
+    midi_reopen();
+
+    std::printf("%s\n", failures ? "failed" : "ok");
+    return failures != 0;
+}
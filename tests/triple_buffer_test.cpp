@@ -0,0 +1,65 @@
+// TripleBuffer under a writer committing as fast as it can: every value
+// the reader sees is whole, and never older than one it saw before
+
+#include "audioplus/triple_buffer.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+static int failures = 0;
+#define CHECK(cond) do { if(!(cond)) { \
+    std::printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); failures++; } } while(0)
+
+using namespace audioplus;
+
+// big enough that a torn copy shows up as mismatched words
+struct Value
+{
+    uint64_t seq = 0;
+    uint64_t words[15] = {};
+};
+
+static uint64_t word(uint64_t seq, int i)
+{
+    return seq * 0x9E3779B97F4A7C15ull + i;
+}
+
+int main()
+{
+    constexpr uint64_t commits = 1000000;
+    TripleBuffer<Value> buffer;
+
+    std::thread writer([&] {
+        for(uint64_t seq=1 ; seq<=commits ; seq++)
+        {
+            Value & v = buffer.write_slot();
+            v.seq = seq;
+            for(int i=0 ; i<15 ; i++) { v.words[i] = word(seq, i); }
+            buffer.write_commit();
+        }
+    });
+
+    uint64_t last = 0;
+    int torn = 0;
+    int older = 0;
+    int reads = 0;
+    while(last < commits)
+    {
+        Value const& v = buffer.read_slot();
+        for(int i=0 ; v.seq && i<15 ; i++) { torn += v.words[i] != word(v.seq, i); }
+        older += v.seq < last;
+        last = v.seq;
+        reads++;
+    }
+    writer.join();
+
+    CHECK(torn == 0);
+    CHECK(older == 0);
+    CHECK(!buffer.read_ready());
+    CHECK(buffer.read_slot().seq == commits);
+    std::printf("%d reads\n", reads);
+
+    std::printf("%s\n", failures ? "failed" : "ok");
+    return failures != 0;
+}
@@ -0,0 +1,161 @@
+// after the header, WavStream sample io must not touch the global heap
+// when it is given a bounded memory_resource
+
+#include "audioplus/wav.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+#include <sstream>
+#include <streambuf>
+
+static bool g_counting = false;
+static int g_allocs = 0;
+
+void * operator new(size_t size)
+{
+    if(g_counting) { g_allocs++; }
+    void * p = std::malloc(size ? size : 1);
+    if(!p) { throw std::bad_alloc(); }
+    return p;
+}
+void operator delete(void * p) noexcept { std::free(p); }
+void operator delete(void * p, size_t) noexcept { std::free(p); }
+
+void * operator new(size_t size, std::align_val_t align)
+{
+    if(g_counting) { g_allocs++; }
+    size_t a = size_t(align);
+#ifdef _WIN32
+    void * p = _aligned_malloc(size ? size : 1, a);
+#else
+    void * p = std::aligned_alloc(a, (size + a - 1) / a * a + (size ? 0 : a));
+#endif
+    if(!p) { throw std::bad_alloc(); }
+    return p;
+}
+void operator delete(void * p, std::align_val_t) noexcept
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+void operator delete(void * p, size_t, std::align_val_t align) noexcept
+{
+    operator delete(p, align);
+}
+
+static int failures = 0;
+#define CHECK(cond) do { if(!(cond)) { \
+    std::printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); failures++; } } while(0)
+
+using namespace audioplus;
+
+// fixed size seekable output, so the stream itself never grows
+struct FixedBuf : std::streambuf
+{
+    std::vector<char> data;
+    size_t end = 0;
+
+    FixedBuf(size_t size) : data(size) { setp(data.data(), data.data() + size); }
+
+    size_t size() { return end = std::max(end, size_t(pptr() - pbase())); }
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode) override
+    {
+        off_type base = dir == std::ios_base::beg ? 0 :
+            dir == std::ios_base::cur ? pptr() - pbase() : off_type(size());
+        off_type pos = base + off;
+        if(pos < 0 || pos > off_type(data.size())) { return pos_type(off_type(-1)); }
+        size();
+        setp(data.data(), data.data() + data.size());
+        pbump(int(pos));
+        return pos_type(pos);
+    }
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+    {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+static constexpr int channels = 2;
+static constexpr int frames = 48000;
+static constexpr int chunk = 256; // frames per io call, like an audio callback
+
+static std::vector<float> signal()
+{
+    std::vector<float> x(frames * channels);
+    for(size_t i=0 ; i<x.size() ; i++) { x[i] = 0.5f * std::sin(0.01f * i); }
+    return x;
+}
+
+// write through a bounded arena, counting heap use from the first sample on
+static std::string write_file(WavHeader::DType dtype, std::vector<float> const& x)
+{
+    FixedBuf buf(frames * channels * 4 + 4096);
+    std::ostream out(&buf);
+    char arena[16384];
+    std::pmr::monotonic_buffer_resource pool(arena, sizeof(arena),
+        std::pmr::null_memory_resource());
+    {
+        auto wav = make_wav_stream(out, &pool);
+        WavHeader header {48000, channels, frames, dtype};
+        CHECK(wav.write(&header) == 0);
+
+        g_allocs = 0;
+        g_counting = true;
+        for(int i=0 ; i<frames ; i+=chunk)
+        {
+            int n = std::min(chunk, frames - i) * channels;
+            CHECK(wav.write(x.data() + i * channels, n) == n);
+        }
+        wav.finish();
+        g_counting = false;
+        CHECK(g_allocs == 0);
+    }
+    return std::string(buf.data.data(), buf.size());
+}
+
+static void read_file(std::string const& bytes, std::vector<float> const& x, float tolerance)
+{
+    std::istringstream in(bytes);
+    char arena[16384];
+    std::pmr::monotonic_buffer_resource pool(arena, sizeof(arena),
+        std::pmr::null_memory_resource());
+    auto wav = make_wav_stream(in, &pool);
+    WavHeader header;
+    CHECK(wav.read(&header) == 0);
+    CHECK(header.frames == frames && header.channels == channels);
+
+    std::vector<float> y(x.size());
+    g_allocs = 0;
+    g_counting = true;
+    int total = 0;
+    for(int i=0 ; i<frames ; i+=chunk)
+    {
+        int got = wav.read(y.data() + i * channels, chunk * channels);
+        if(got <= 0) { break; }
+        total += got;
+    }
+    g_counting = false;
+    CHECK(g_allocs == 0);
+    CHECK(total == frames * channels);
+
+    float err = 0;
+    for(size_t i=0 ; i<x.size() ; i++) { err = std::max(err, std::fabs(x[i] - y[i])); }
+    CHECK(err <= tolerance);
+}
+
+int main()
+{
+    std::vector<float> x = signal();
+    read_file(write_file(WavHeader::Float32, x), x, 0.0f);
+    read_file(write_file(WavHeader::Int24, x), x, 1.0f / 8388608);
+
+    std::printf("%s\n", failures ? "failed" : "ok");
+    return failures != 0;
+}
@@ -0,0 +1,123 @@
+// a wav of unknown length through a pipe: FdOStream on a writer thread,
+// FdIStream + read_all on this one, every sample comes back
+// big enough to wrap the pipe buffer and take several read_all chunks
+// then read() / write() failing mid-stream: both sides report an error
+// with its errno, instead of ending as if at EOF
+
+#include "audioplus/fd_stream.h"
+#include "audioplus/wav.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <thread>
+#include <unistd.h>
+
+static std::atomic<int> failures {0};
+#define CHECK(cond) do { if(!(cond)) { \
+    std::printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); failures++; } } while(0)
+
+using namespace audioplus;
+
+static constexpr int channels = 2;
+static constexpr int frames = 1 << 20;
+static constexpr int chunk = 4096; // frames per write
+
+static float sample(int i)
+{
+    return 0.5f * std::sin(0.001f * i);
+}
+
+static void writer(int fd)
+{
+    FdOStream out(fd, FdStreamBuf::default_buffer, true); // closes, reader sees EOF
+    auto wav = make_wav_stream(out);
+    WavHeader header {48000, channels, WavHeader::unknown_frames, WavHeader::Float32};
+    CHECK(wav.write(&header) == 0);
+
+    std::vector<float> x(chunk * channels);
+    for(int i=0 ; i<frames ; i+=chunk)
+    {
+        for(int k=0 ; k<chunk * channels ; k++) { x[k] = sample(i * channels + k); }
+        CHECK(wav.write(x.data(), chunk * channels) == chunk * channels);
+    }
+    wav.finish();
+}
+
+static void round_trip()
+{
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+    std::thread thread(writer, fds[1]);
+
+    std::vector<float> y;
+    int64_t count;
+    {
+        FdIStream in(fds[0], FdStreamBuf::default_buffer, true);
+        auto wav = make_wav_stream(in);
+        count = wav.read_all(y);
+    }
+    thread.join();
+
+    CHECK(count == int64_t(frames) * channels);
+    CHECK(y.size() == size_t(frames) * channels);
+    int bad = 0;
+    for(size_t i=0 ; i<y.size() ; i++) { bad += y[i] != sample(int(i)); }
+    CHECK(bad == 0);
+}
+
+// writes until the pipe breaks
+static void broken_writer(int fd, int * result, int * error)
+{
+    FdOStream out(fd, 4096, true);
+    auto wav = make_wav_stream(out);
+    WavHeader header {48000, channels, WavHeader::unknown_frames, WavHeader::Float32};
+    CHECK(wav.write(&header) == 0);
+    std::vector<float> x(chunk * channels, 0.25f);
+    do { *result = wav.write(x.data(), int(x.size())); } while(*result > 0);
+    *error = out.m_buf.error();
+}
+
+static void io_errors()
+{
+    std::signal(SIGPIPE, SIG_IGN); // EPIPE instead
+    int fds[2];
+    int other[2];
+    CHECK(pipe(fds) == 0 && pipe(other) == 0);
+    int write_result = 0;
+    int write_error = 0;
+    std::thread thread(broken_writer, fds[1], &write_result, &write_error);
+
+    FdIStream in(fds[0], 4096, true);
+    auto wav = make_wav_stream(in);
+    WavHeader header;
+    CHECK(wav.read(&header) == 0);
+    std::vector<float> y(chunk * channels);
+    for(int i=0 ; i<10 ; i++) { CHECK(wav.read(y.data(), int(y.size())) > 0); }
+
+    // the reader's fd turns into a write end: read() fails with EBADF, and
+    // with its read end gone the writer's pipe breaks
+    dup2(other[1], fds[0]);
+    int got = 0;
+    for(int i=0 ; i<1000 && got >= 0 ; i++) { got = wav.read(y.data(), int(y.size())); }
+    CHECK(got < 0);
+    CHECK(wav.error_message != nullptr);
+    CHECK(in.bad());
+    CHECK(in.m_buf.error() == EBADF);
+    thread.join();
+    CHECK(write_result < 0);
+    CHECK(write_error == EPIPE);
+    close(other[0]);
+    close(other[1]);
+}
+
+int main()
+{
+    round_trip();
+    io_errors();
+
+    std::printf("%s\n", failures ? "failed" : "ok");
+    return failures != 0;
+}